@@ -27,13 +27,18 @@
 #include <cstdio>
 #include <ctype.h>
 #include <cstring>
+#include <climits>
 #include <queue>
 #include <algorithm>
+#include <thread>
+#include <atomic>
 
 #include "report.h"
 #include "counters.h"
 #include "files.hh"
 #include "compile.hh"
+#include "reader.hh"
+#include "microsat.hh"
 // From glucose
 #include "Solver.h"
 
@@ -42,7 +47,31 @@
 // Disabled here
 
 #define RANDOM_BVE 0
-#define STACK_BVE 0
+
+// BVE considers variables whose estimated clause growth exceeds the limit by at most this amount,
+// in case subsumed and tautological resolvents bring them under the limit
+#define BVE_COST_SLACK 8
+// Don't scan occurrence lists longer than this when checking for subsumption
+#define SUBSUME_MAX_OCCURRENCE 100
+// Maximum number of variables eliminated together by parallel BVE
+#define BVE_BATCH_SIZE 1024
+// Don't look for gate definitions of variables with more occurrences than this
+#define GATE_MAX_OCCURRENCE 100
+// Only use gate definitions when BVE allows at least this degree.
+// Eliminating gates during the initial BVE makes the later Tseitin tests harder
+#define GATE_MIN_DEGREE 2
+// Maximum number of variables tested together by parallel classification
+#define TSEITIN_BATCH_SIZE 256
+
+// Default limits on clauses added by Tseitin promotion.
+// Expansion of a single variable beyond the first limit uses auxiliary variables instead
+#define PROMOTE_VARIABLE_LIMIT 64
+#define PROMOTE_TOTAL_LIMIT 100000
+
+// Compact clause storage once literals of inactive clauses make up this fraction of the
+// literal sequence and exceed the minimum count
+#define GC_WASTE_FRACTION 0.2
+#define GC_MIN_WASTE 100000
 
 // Implementation of FIFO queues that don't store duplicates
 template <typename T> class unique_queue {
@@ -101,6 +130,236 @@ public:
 
 };
 
+occurrence_lists::occurrence_lists(std::vector<int> *coffset, std::vector<int> *lseq) {
+    clause_offset = coffset;
+    literal_sequence = lseq;
+}
+
+void occurrence_lists::initialize(int nvar) {
+    lists.clear();
+    lists.resize(2*(nvar+1));
+    position.clear();
+}
+
+bool occurrence_lists::add(int lit, int cid, int pos) {
+    int c = LCODE(lit);
+    if (c >= lists.size())
+	lists.resize(c + 2 - c%2);
+    std::vector<int> &list = lists[c];
+    if (list.size() > 0 && list.back() == cid)
+	return false;
+    if (pos >= position.size())
+	position.resize(pos+1 > literal_sequence->size() ? pos+1 : literal_sequence->size());
+    position[pos] = list.size();
+    list.push_back(cid);
+    return true;
+}
+
+void occurrence_lists::remove(int lit, int cid, int pos) {
+    int c = LCODE(lit);
+    if (c >= lists.size() || pos >= position.size())
+	return;
+    std::vector<int> &list = lists[c];
+    int idx = position[pos];
+    if (idx < 0 || idx >= list.size() || list[idx] != cid)
+	return;
+    int ocid = list.back();
+    list.pop_back();
+    if (ocid == cid)
+	return;
+    // Move last clause into vacated slot
+    list[idx] = ocid;
+    for (int opos = (*clause_offset)[ocid-1]; opos < (*clause_offset)[ocid]; opos++) {
+	if ((*literal_sequence)[opos] == lit) {
+	    position[opos] = idx;
+	    break;
+	}
+    }
+}
+
+void occurrence_lists::renumber(std::vector<int> &cid_map) {
+    for (std::vector<int> &list : lists) {
+	for (int i = 0; i < list.size(); i++)
+	    list[i] = cid_map[list[i]];
+    }
+    if (position.size() > literal_sequence->size())
+	position.resize(literal_sequence->size());
+}
+
+bool clause_set::insert(int cid) {
+    if (is_member(cid))
+	return false;
+    int w = cid >> 6;
+    uint64_t bit = (uint64_t) 1 << (cid & 63);
+    if (w >= member_bits.size()) {
+	int nwords = w+1 > 2*member_bits.size() ? w+1 : 2*member_bits.size();
+	member_bits.resize(nwords, 0);
+	listed_bits.resize(nwords, 0);
+    }
+    member_bits[w] |= bit;
+    count++;
+    if (!(listed_bits[w] & bit)) {
+	listed_bits[w] |= bit;
+	if (nsorted == members.size() && (members.size() == 0 || members.back() < cid))
+	    nsorted++;
+	members.push_back(cid);
+    }
+    return true;
+}
+
+void clause_set::erase(int cid) {
+    if (!is_member(cid))
+	return;
+    member_bits[cid >> 6] &= ~((uint64_t) 1 << (cid & 63));
+    count--;
+}
+
+void clause_set::clear() {
+    for (int cid : members) {
+	uint64_t mask = ~((uint64_t) 1 << (cid & 63));
+	member_bits[cid >> 6] &= mask;
+	listed_bits[cid >> 6] &= mask;
+    }
+    members.clear();
+    nsorted = 0;
+    count = 0;
+}
+
+void clause_set::compact() {
+    if (count == members.size() && nsorted == members.size())
+	return;
+    int nprefix = 0;
+    int j = 0;
+    for (int i = 0; i < members.size(); i++) {
+	int cid = members[i];
+	if (is_member(cid)) {
+	    members[j++] = cid;
+	    if (i < nsorted)
+		nprefix++;
+	} else
+	    listed_bits[cid >> 6] &= ~((uint64_t) 1 << (cid & 63));
+    }
+    members.resize(j);
+    if (nprefix < j) {
+	std::sort(members.begin() + nprefix, members.end());
+	std::inplace_merge(members.begin(), members.begin() + nprefix, members.end());
+    }
+    nsorted = j;
+}
+
+void occurrence_lists::swap_positions(int pos1, int pos2) {
+    if (pos1 >= position.size() || pos2 >= position.size())
+	return;
+    int tpos = position[pos1];
+    position[pos1] = position[pos2];
+    position[pos2] = tpos;
+}
+
+void variable_heap::initialize(int nvar) {
+    heap.clear();
+    index.assign(nvar+1, -1);
+    cost.assign(nvar+1, 0);
+    operation_count = 0;
+}
+
+void variable_heap::clear() {
+    for (int var : heap)
+	index[var] = -1;
+    heap.clear();
+}
+
+void variable_heap::sift_up(int pos) {
+    int var = heap[pos];
+    while (pos > 0) {
+	int ppos = (pos-1)/2;
+	if (!less(var, heap[ppos]))
+	    break;
+	place(pos, heap[ppos]);
+	pos = ppos;
+    }
+    place(pos, var);
+}
+
+void variable_heap::sift_down(int pos) {
+    int var = heap[pos];
+    int n = heap.size();
+    while (true) {
+	int cpos = 2*pos+1;
+	if (cpos >= n)
+	    break;
+	if (cpos+1 < n && less(heap[cpos+1], heap[cpos]))
+	    cpos++;
+	if (!less(heap[cpos], var))
+	    break;
+	place(pos, heap[cpos]);
+	pos = cpos;
+    }
+    place(pos, var);
+}
+
+void variable_heap::update(int var, int c) {
+    operation_count++;
+    int pos = index[var];
+    if (pos < 0) {
+	cost[var] = c;
+	heap.push_back(var);
+	sift_up(heap.size()-1);
+    } else if (c < cost[var]) {
+	cost[var] = c;
+	sift_up(pos);
+    } else if (c > cost[var]) {
+	cost[var] = c;
+	sift_down(pos);
+    }
+}
+
+void resolve_scratch::initialize(int nvar) {
+    variable_stamp.assign(nvar+1, 0);
+    resolve_stamp = 0;
+    literal_mark.assign(2*(nvar+1), 0);
+    gate_binary.assign(2*(nvar+1), 0);
+}
+
+void resolve_scratch::resize(int nvar) {
+    variable_stamp.resize(nvar+1, 0);
+    literal_mark.resize(2*(nvar+1), 0);
+    gate_binary.resize(2*(nvar+1), 0);
+}
+
+void tseitin_oracle::initialize(int nvar) {
+    solver = new Glucose::Solver();
+    solver->verbosity = 0;
+    solver_var.assign(nvar+1, -1);
+}
+
+void tseitin_oracle::deallocate() {
+    delete solver;
+    solver = NULL;
+    solver_var.clear();
+}
+
+void variable_heap::remove(int var) {
+    int pos = index[var];
+    if (pos < 0)
+	return;
+    operation_count++;
+    index[var] = -1;
+    int lvar = heap.back();
+    heap.pop_back();
+    if (lvar == var)
+	return;
+    // Move last variable into vacated slot
+    place(pos, lvar);
+    sift_up(pos);
+    sift_down(index[lvar]);
+}
+
+int variable_heap::pop() {
+    int var = heap[0];
+    remove(var);
+    return var;
+}
+
 #if RANDOM_BVE
 ///////////////////////////////////////////////////////////////////
 // Managing pairs of ints packed into 64-bit word
@@ -171,11 +430,6 @@ private:
 
 //////////////// Reading CNF FILE ///////////////////
 
-// Put literals in ascending order of the variables
-static bool abs_less(int x, int y) {
-    return IABS(x) < IABS(y);
-}
-
 
 static int skip_line(FILE *infile) {
     int c;
@@ -267,8 +521,55 @@ static void process_comment(FILE *infile, std::unordered_set<int> *data_variable
     skip_line(infile);
 }		
 
+//////////////// Reading CNF from memory-mapped input ///////////////////
+
+// Process comment, looking additional data variables & weights
+// Unlike the FILE-based version, only search the remainder of the comment line for keywords
+static void process_comment(Reader &in, std::unordered_set<int> *data_variables , std::unordered_map<int,q25_ptr> *input_weights) {
+    char buf[50];
+    if (in.read_token(buf, 50) == 1 && buf[0] == 'p') {
+	int len = in.read_token(buf, 50);
+	if (len == 4 && strncmp(buf, "show", 4) == 0) {
+	    int var = -1;
+	    while (var != 0) {
+		if (!in.read_int(&var)) {
+		    err(false, "Couldn't read data variable\n");
+		    break;
+		} else if (var != 0) {
+		    data_variables->insert(var);
+		}
+	    }
+	}
+	else if (len == 6 && strncmp(buf, "weight", 6) == 0) {
+	    int lit = 0;
+	    if (!in.read_int(&lit)) {
+		err(false, "Couldn't read weight literal (skipping)\n");
+		in.skip_line();
+		return;
+	    }
+	    char wbuf[100];
+	    in.skip_space();
+	    int wlen = in.read_token(wbuf, 100);
+	    int qlen = 0;
+	    q25_ptr wt = q25_from_string(wbuf, &qlen);
+	    // Entire token must be consumed
+	    if (wlen == 0 || !q25_is_valid(wt) || qlen != wlen) {
+		err(false, "Couldn't read weight for literal %d (skipping)\n", lit);
+		q25_free(wt);
+		in.skip_line();
+		return;
+	    }
+	    (*input_weights)[lit] = wt;
+	    int zero;
+	    if (!in.read_int(&zero) || zero != 0) {
+		err(false, "Couldn't read terminating zero in weight declaration for literal %d (accepting weight)\n", lit);
+	    }
+	}
+    }
+    in.skip_line();
+}		
+
 Cnf::Cnf() {
-    variable_type = NULL;
     data_variables = NULL;
     tseitin_variables = NULL;
     active_clauses = NULL;
@@ -278,7 +579,6 @@ Cnf::Cnf() {
 }
 
 Cnf::Cnf(int input_count) {
-    variable_type = NULL;
     data_variables = NULL;
     tseitin_variables = NULL;
     active_clauses = NULL;
@@ -295,11 +595,7 @@ Cnf::~Cnf() {
 
 void Cnf::initialize(int input_count) {
     nvar = input_count;
-    if (variable_type)
-	delete variable_type;
-    variable_type = new var_t[nvar];
-    for (int v = 1; v <= nvar; v++)
-	set_variable_type(v, VAR_UNUSED);
+    variable_type.assign(nvar, VAR_UNUSED);
     clause_offset.clear();
     literal_sequence.clear();
     if (data_variables)
@@ -313,27 +609,38 @@ void Cnf::initialize(int input_count) {
     if (active_clauses) {
 	active_clauses->clear();
     } else
-	active_clauses = new std::set<int>;
-    if (literal_clauses) {
-	literal_clauses->clear();
-    } else
-	literal_clauses = new std::unordered_map<int,std::unordered_set<int>>;
+	active_clauses = new clause_set;
+    if (!literal_clauses)
+	literal_clauses = new occurrence_lists(&clause_offset, &literal_sequence);
+    literal_clauses->initialize(nvar);
     if (input_weights)
 	input_weights->clear();
     else
 	input_weights = new std::unordered_map<int, q25_ptr>;
+    var_state.assign(nvar+1, {0, false, 0});
+    trail.clear();
+    context_level = 0;
+    bcp_unit_count = 0;
+    trail_head = 0;
+    active_literal_count = 0;
+    bve_queue.initialize(nvar);
+    scratch.initialize(nvar);
+    clause_signature.clear();
+    watch_literals.clear();
+    watch_lists.clear();
+    watch_lists.resize(2*(nvar+1));
+    unwatched_clauses.clear();
+    promote_variable_limit = PROMOTE_VARIABLE_LIMIT;
+    promote_total_limit = PROMOTE_TOTAL_LIMIT;
+    promote_clause_count = 0;
     new_clause();
     has_conflict = false;
     action_stack.clear();
     new_context();
-    unit_literals.clear();
-    bcp_unit_literals.clear();
-    uquantified_variables.clear();
 }
 
 // Must explicitly deallocate sets
 void Cnf::deallocate() {
-    delete variable_type;
     delete data_variables;
     delete tseitin_variables;
     delete active_clauses;
@@ -344,16 +651,25 @@ void Cnf::deallocate() {
 int Cnf::new_clause() {
     int cid = clause_offset.size();
     clause_offset.push_back(literal_sequence.size());
-    if (cid > 0)
+    clause_signature.push_back(0);
+    watch_literals.push_back(0);
+    watch_literals.push_back(0);
+    if (cid > 0) {
 	active_clauses->insert(cid);
+	unwatched_clauses.push_back(cid);
+    }
     return cid;
 }
 
 void Cnf::add_literal(int lit) {
+    int cid = clause_offset.size()-1;
+    // Drop duplicate literals
+    if (!literal_clauses->add(lit, cid, literal_sequence.size()))
+	return;
     literal_sequence.push_back(lit);
     clause_offset.back() ++;
-    int cid = clause_offset.size()-1;
-    (*literal_clauses)[lit].insert(cid);
+    clause_signature.back() |= literal_signature(lit);
+    active_literal_count++;
     int var = IABS(lit);
     if (get_variable_type(var) == VAR_UNUSED)
 	set_variable_type(var, VAR_NONTSEITIN);
@@ -464,6 +780,308 @@ bool Cnf::import_file(FILE *infile, bool process_comments) {
     return true;
 }
 
+// Single pass over memory-mapped input.
+// Accepts the same files as import_file and builds an identical CNF
+bool Cnf::import_reader(Reader &in, bool process_comments) { 
+    int expectedNclause = 0;
+    bool got_header = false;
+    int c;
+    // Look for CNF header
+    while ((c = in.get()) != EOF) {
+	if (isspace(c)) 
+	    continue;
+	if (c == 'c') {
+	    if (process_comments)
+		process_comment(in, data_variables, input_weights);
+	    else
+		in.skip_line();
+	    continue;
+	}
+	if (c == 'p') {
+	    char field[20];
+	    in.skip_space();
+	    in.read_token(field, 20);
+	    if (strcmp(field, "cnf") != 0) {
+		err(false, "Not valid CNF file.  Header line shows type is '%s'\n", field);
+		return false;
+	    }
+	    if (!in.read_int(&nvar) || !in.read_int(&expectedNclause)) {
+		err(false, "Invalid CNF header\n");
+		return false;
+	    } 
+	    initialize(nvar);
+	    // Size clause storage from header.  Every literal requires at least two characters
+	    clause_offset.reserve(expectedNclause+1);
+	    literal_sequence.reserve(in.remaining()/2);
+	    in.skip_line();
+	    got_header = true;
+	    break;
+	}
+    }
+    if (!got_header) {
+	err(false, "Not valid CNF.  No header line found\n");
+	return false;
+    }
+    while (maximum_clause_id() < expectedNclause) {
+	// Setup next clause
+	new_clause();
+	bool starting_clause = true;
+	while (true) {
+	    int lit;
+	    c = in.skip_space();
+	    if (c == EOF) {
+		err(false, "Unexpected end of file\n");
+		return false;
+	    } else if (c == 'c' && starting_clause) {
+		in.get();
+		if (process_comments)
+		    process_comment(in, data_variables, input_weights);
+		else
+		    in.skip_line();
+		continue;
+	    }
+	    else if (!in.read_int(&lit)) {
+		err(false, "Couldn't find literal or 0\n");
+		return false;
+	    }
+	    if (lit == 0)
+		break;
+	    else 
+		add_literal(lit);
+	    starting_clause = false;
+	}
+    }
+    while ((c = in.get()) != EOF) {
+	if (c == 'c') {
+	    if (process_comments)
+		process_comment(in, data_variables, input_weights);
+	    else
+		in.skip_line();
+	}
+    }
+    // If no data variables declared, assume all input variables are data variables
+    if (data_variables->size() == 0) {
+	for (int v = 1; v <= variable_count(); v++)
+	    data_variables->insert(v);
+    }
+    for (int v : *data_variables)
+	set_variable_type(v, VAR_DATA);
+    incr_count_by(COUNT_INPUT_CLAUSE, maximum_clause_id());
+    return true;
+}
+
+//////////////// Binary snapshots of preprocessed CNF ///////////////////
+
+// Snapshot layout.  All fields are 32-bit words in native byte order:
+//   Header (struct snapshot_header)
+//   Variable types:  nvar words
+//   BCP unit literals: nunit words
+//   Clauses:  Literals of each active clause followed by 0.  nclause clauses
+//   Data variables: ndata words
+//   Tseitin variables: ntseitin words
+//   Weights: nweight entries, each consisting of the literal,
+//            followed by the weight as a zero-terminated decimal string, padded to a word boundary
+
+#define SNAPSHOT_MAGIC "PKCSNAP"
+#define SNAPSHOT_VERSION 4
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+// Preprocessing statistics carried along with the formula
+static counter_t snapshot_counters[SNAPSHOT_COUNTERS] =
+    { COUNT_INPUT_CLAUSE, COUNT_BVE_ELIM_CLAUSE, COUNT_BVE_NEW_CLAUSE, COUNT_BVE_SUBSUME_CLAUSE,
+      COUNT_BVE_STRENGTHEN_CLAUSE, COUNT_PROMOTE_CLAUSE, COUNT_PROMOTE_AUX_VAR, COUNT_TSEITIN_TEST,
+      COUNT_TSEITIN_GATE_DETECT, COUNT_TSEITIN_SAT_DETECT };
+
+bool is_snapshot(const char *buf, size_t len) {
+    return len >= sizeof(snapshot_header) && memcmp(buf, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0;
+}
+
+static void write_word(FILE *outfile, int32_t val) {
+    fwrite(&val, sizeof(int32_t), 1, outfile);
+}
+
+bool Cnf::write_snapshot(FILE *outfile, int preprocess_level, char tseitin_mode) {
+    snapshot_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    hdr.version = SNAPSHOT_VERSION;
+    hdr.byte_order = SNAPSHOT_BYTE_ORDER;
+    hdr.preprocess_level = preprocess_level;
+    hdr.tseitin_mode = tseitin_mode;
+    hdr.nvar = nvar;
+    std::vector<int> units;
+    get_bcp_units(units);
+    hdr.nunit = units.size();
+    hdr.ndata = data_variables->size();
+    hdr.ntseitin = tseitin_variables->size();
+    hdr.nweight = input_weights->size();
+    for (int i = 0; i < SNAPSHOT_COUNTERS; i++)
+	hdr.counters[i] = get_count(snapshot_counters[i]);
+    // Gather clauses, omitting satisfied clauses and falsified literals
+    std::vector<int> clause_chunks;
+    for (int cid : *active_clauses) {
+	if (skip_clause(cid))
+	    continue;
+	int len = clause_length(cid);
+	for (int lid = 0; lid < len; lid++) {
+	    int lit = get_literal(cid, lid);
+	    if (!skip_literal(lit))
+		clause_chunks.push_back(lit);
+	}
+	clause_chunks.push_back(0);
+	hdr.nclause++;
+    }
+    hdr.nliteral = clause_chunks.size() - hdr.nclause;
+    if (fwrite(&hdr, sizeof(hdr), 1, outfile) != 1)
+	return false;
+    for (int v = 1; v <= nvar; v++)
+	write_word(outfile, (int32_t) get_variable_type(v));
+    for (int lit : units)
+	write_word(outfile, lit);
+    for (int lit : clause_chunks)
+	write_word(outfile, lit);
+    // Sort sets so that snapshots are reproducible
+    std::vector<int> vars(data_variables->begin(), data_variables->end());
+    std::sort(vars.begin(), vars.end());
+    for (int v : vars)
+	write_word(outfile, v);
+    vars.assign(tseitin_variables->begin(), tseitin_variables->end());
+    std::sort(vars.begin(), vars.end());
+    for (int v : vars)
+	write_word(outfile, v);
+    for (auto kv : *input_weights) {
+	write_word(outfile, kv.first);
+	long start = ftell(outfile);
+	q25_write(kv.second, outfile);
+	fputc('\0', outfile);
+	while ((ftell(outfile) - start) % sizeof(int32_t) != 0)
+	    fputc('\0', outfile);
+    }
+    report(3, "Wrote snapshot with %d variables, %d clauses, and %d unit literals\n", nvar, hdr.nclause, hdr.nunit);
+    return !ferror(outfile);
+}
+
+bool Cnf::import_snapshot(const char *buf, size_t len, int preprocess_level, char tseitin_mode) {
+    if (!is_snapshot(buf, len)) {
+	err(false, "Not a valid snapshot\n");
+	return false;
+    }
+    const snapshot_header *hdr = (const snapshot_header *) buf;
+    if (hdr->version != SNAPSHOT_VERSION) {
+	err(false, "Snapshot has version %d.  Expected version %d\n", hdr->version, SNAPSHOT_VERSION);
+	return false;
+    }
+    if (hdr->byte_order != SNAPSHOT_BYTE_ORDER) {
+	err(false, "Snapshot was written on machine with different byte order\n");
+	return false;
+    }
+    if (hdr->nvar < 0 || hdr->nclause < 0 || hdr->nliteral < 0 || hdr->nunit < 0
+	|| hdr->ndata < 0 || hdr->ntseitin < 0 || hdr->nweight < 0) {
+	err(false, "Invalid counts in snapshot header\n");
+	return false;
+    }
+    size_t nword = (size_t) hdr->nvar + hdr->nunit + hdr->nliteral + hdr->nclause + hdr->ndata + hdr->ntseitin + 2 * (size_t) hdr->nweight;
+    if (len < sizeof(snapshot_header) + nword * sizeof(int32_t)) {
+	err(false, "Snapshot truncated\n");
+	return false;
+    }
+    const int32_t *words = (const int32_t *) (buf + sizeof(snapshot_header));
+    const int32_t *wend = (const int32_t *) (buf + len);
+    initialize(hdr->nvar);
+    clause_offset.reserve(hdr->nclause + 1);
+    literal_sequence.reserve(hdr->nliteral);
+    const int32_t *types = words;
+    words += nvar;
+    const int32_t *units = words;
+    words += hdr->nunit;
+    for (int i = 0; i < hdr->nclause; i++) {
+	new_clause();
+	while (true) {
+	    if (words >= wend) {
+		err(false, "Snapshot truncated\n");
+		return false;
+	    }
+	    int lit = *words++;
+	    if (lit == 0)
+		break;
+	    if (IABS(lit) > nvar) {
+		err(false, "Invalid literal %d in snapshot\n", lit);
+		return false;
+	    }
+	    add_literal(lit);
+	}
+    }
+    // Set types after adding clauses, since adding literals changes types of unused variables
+    for (int v = 1; v <= nvar; v++) {
+	int t = types[v-1];
+	if (t < 0 || t >= VAR_NUM) {
+	    err(false, "Invalid type %d for variable %d in snapshot\n", t, v);
+	    return false;
+	}
+	set_variable_type(v, (var_t) t);
+    }
+    for (int i = 0; i < hdr->nunit; i++) {
+	int lit = units[i];
+	if (lit == 0 || IABS(lit) > nvar) {
+	    err(false, "Invalid unit literal %d in snapshot\n", lit);
+	    return false;
+	}
+	assign_literal(lit, true);
+    }
+    if (words + hdr->ndata + hdr->ntseitin > wend) {
+	err(false, "Snapshot truncated\n");
+	return false;
+    }
+    for (int i = 0; i < hdr->ndata + hdr->ntseitin; i++) {
+	int var = *words++;
+	if (var < 1 || var > nvar) {
+	    err(false, "Invalid %s variable %d in snapshot\n", i < hdr->ndata ? "data" : "Tseitin", var);
+	    return false;
+	}
+	if (i < hdr->ndata)
+	    data_variables->insert(var);
+	else
+	    tseitin_variables->insert(var);
+    }
+    for (int i = 0; i < hdr->nweight; i++) {
+	if (words >= wend) {
+	    err(false, "Snapshot truncated\n");
+	    return false;
+	}
+	int lit = *words++;
+	if (lit == 0 || IABS(lit) > nvar) {
+	    err(false, "Invalid weight literal %d in snapshot\n", lit);
+	    return false;
+	}
+	const char *wstring = (const char *) words;
+	int wlen = strnlen(wstring, (const char *) wend - wstring);
+	// Weight string must be terminated within the snapshot before it can be parsed
+	if (wlen == (const char *) wend - wstring) {
+	    err(false, "Snapshot truncated\n");
+	    return false;
+	}
+	q25_ptr wt = q25_from_string(wstring, NULL);
+	if (!q25_is_valid(wt)) {
+	    err(false, "Invalid weight for literal %d in snapshot\n", lit);
+	    q25_free(wt);
+	    return false;
+	}
+	(*input_weights)[lit] = wt;
+	words += (wlen + sizeof(int32_t)) / sizeof(int32_t);
+    }
+    for (int i = 0; i < SNAPSHOT_COUNTERS; i++)
+	incr_count_by(snapshot_counters[i], hdr->counters[i]);
+    report(1, "Loaded snapshot preprocessed with level %d and Tseitin mode '%c'\n", hdr->preprocess_level, hdr->tseitin_mode);
+    // Preprocessing is not repeated, so the snapshot's settings take effect
+    if (hdr->preprocess_level != preprocess_level)
+	err(false, "Snapshot was preprocessed with level %d, not requested level %d.  Using snapshot\n",
+	    hdr->preprocess_level, preprocess_level);
+    if (hdr->tseitin_mode != tseitin_mode)
+	err(false, "Snapshot was generated with Tseitin mode '%c', not requested mode '%c'.  Using snapshot\n",
+	    hdr->tseitin_mode, tseitin_mode);
+    return true;
+}
+
 int Cnf::clause_length(int cid) {
     if (cid < 1 || cid > maximum_clause_id())
 	err(true, "Invalid clause ID: %d\n", cid);
@@ -479,7 +1097,7 @@ int Cnf::nonunit_clause_count() {
 }
 
 int Cnf::current_clause_count() {
-    return active_clauses->size() + bcp_unit_literals.size();
+    return active_clauses->size() + bcp_unit_count;
 }
 
 int Cnf::get_literal(int cid, int lid) {
@@ -498,10 +1116,13 @@ void Cnf::swap_literals(int cid, int i, int j) {
     int tlit = literal_sequence[offset+i];
     literal_sequence[offset+i] = literal_sequence[offset+j];
     literal_sequence[offset+j] = tlit;
+    literal_clauses->swap_positions(offset+i, offset+j);
 }
 
 bool Cnf::show(FILE *outfile) {
-    for (int lit : bcp_unit_literals)
+    std::vector<int> units;
+    get_bcp_units(units);
+    for (int lit : units)
 	fprintf(outfile, "  UNIT: %d\n", lit);
     for (int cid : *active_clauses) {
 	if (skip_clause(cid))
@@ -523,7 +1144,9 @@ bool Cnf::write(FILE *outfile, bool show_data_and_tseitin_variables) {
     // Figure out which unit literals are data variables
     std::vector<int> data_literals;
     int removed_literals = 0;
-    for (int lit : bcp_unit_literals) {
+    std::vector<int> units;
+    get_bcp_units(units);
+    for (int lit : units) {
 	int var = IABS(lit);
 	if (is_data_variable(var))
 	    data_literals.push_back(lit);
@@ -557,74 +1180,27 @@ bool Cnf::write(FILE *outfile, bool show_data_and_tseitin_variables) {
     return true;
 }
 
-bool Cnf::is_satisfiable() {
-    if (verblevel >= 5) {
-	printf("Calling is_satisfiable for clauses:\n");
-	show(stdout);
-    }
-    bcp(false);
-    if (has_conflict)
-	return false;
-
-    double start = tod();
-    int clause_count = 0;
-    Glucose::Solver solver;
-    solver.verbosity = 0;
-    auto plit = new Glucose::Lit[nvar];
-    auto nlit = new Glucose::Lit[nvar];
-    for (int v = 1; v <= nvar; v++) {
-	Glucose::Var gvar = solver.newVar(true, true);
-	plit[v-1] = Glucose::mkLit(gvar, true);
-	nlit[v-1] = Glucose::mkLit(gvar, false);
-    }
-    Glucose::vec<Glucose::Lit> gclause;
-    for (int lit : bcp_unit_literals) {
-	int var = IABS(lit);
-	gclause.clear();
-	Glucose::Lit glit = lit > 0 ? plit[var-1] : nlit[var-1];
-	gclause.push(glit);
-	solver.addClause(gclause);
-	clause_count++;
-    }
-    for (int cid : *active_clauses) {
-	if (skip_clause(cid))
-	    continue;
-	gclause.clear();
-	int len = clause_length(cid);
-	for (int lid = 0; lid < len; lid++) {
-	    int lit = get_literal(cid, lid);
-	    if (skip_literal(lit))
-		continue;
-	    int var = IABS(lit);
-	    Glucose::Lit glit = lit > 0 ? plit[var-1] : nlit[var-1];
-	    gclause.push(glit);
-	}
-	solver.addClause(gclause);
-	clause_count++;
-    }
-    bool result = solver.solve();
-    double elapsed = tod() - start;
-    incr_timer(TIME_SAT, elapsed);
-    incr_count(COUNT_SAT_CALL);
-    incr_histo(HISTO_SAT_CLAUSES, clause_count);
-    delete[] plit;
-    delete[] nlit;
-    report(5, "Calling SAT solver on problem with %d variables and %d clauses yields %s\n",
-	   nvar, clause_count, result ? "SAT" : "UNSAT");
-    return result;
-}
-
-void Cnf::new_context() {
-    action_stack.push_back({ACTION_START_CONTEXT, 0});    
-}
+void Cnf::new_context() {
+    context_level++;
+    action_stack.push_back({ACTION_START_CONTEXT, trail_head});    
+}
 
 void Cnf::pop_context() {
     while (true) {
 	action_record ar = action_stack.back();
-	active_record avr;
 	action_stack.pop_back();
 	switch (ar.action) {
 	case ACTION_START_CONTEXT:      // Start of new context
+	    // Undo assignments made in this context
+	    while (trail.size() > 0 && var_state[trail.back()].level >= context_level) {
+		variable_state &vs = var_state[trail.back()];
+		if (vs.bcp)
+		    bcp_unit_count--;
+		vs = {0, false, 0};
+		trail.pop_back();
+	    }
+	    context_level--;
+	    trail_head = ar.ele;
 	    return;
 	case ACTION_CONFLICT:           // Found conflict
 	    has_conflict = false;
@@ -632,26 +1208,12 @@ void Cnf::pop_context() {
 	case ACTION_DEACTIVATE_CLAUSE:  // Deactivated clause
 	    activate_clause(ar.ele);
 	    break;
-	case ACTION_BCP:                // Derived unit literal by BCP
-	    bcp_unit_literals.erase(ar.ele);
-	    unit_literals.erase(ar.ele);
-	    break;
-	case ACTION_ASSERT:             // Asserted literal externally
-	    unit_literals.erase(ar.ele);
-	    break;
 	case ACTION_ASSERT_FROM_BCP:    // Converted BCP unit literal into asserted literal
-	    bcp_unit_literals.insert(ar.ele);
+	    var_state[IABS(ar.ele)].bcp = true;
+	    bcp_unit_count++;
 	    break;
-	case ACTION_UQUANTIFY:           // Variable was universally quantfied
-	    uquantified_variables.erase(ar.ele);
-	    break;
-	case ACTION_ACTIVE_CLAUSES:     // Changed set of active clauses
-	    delete active_clauses;
-	    delete literal_clauses;
-	    avr = active_stack.back();
-	    active_stack.pop_back();
-	    active_clauses = avr.active_clauses;
-	    literal_clauses = avr.literal_clauses;
+	case ACTION_UNWATCHED_CLAUSE:   // Clause must be examined again
+	    unwatched_clauses.push_back(ar.ele);
 	    break;
 	default:
 	    err(true, "Unknown action on action stack.  Value = %d\n", ar.action);
@@ -664,10 +1226,11 @@ void Cnf::assign_literal(int lit, bool bcp) {
     if (var == 0 || var > nvar) {
 	err(true, "Can't assign literal %d\n", lit);
     }
-    bool was_unit = unit_literals.find(lit) != unit_literals.end();
-    bool was_bcp_unit = bcp_unit_literals.find(lit) != bcp_unit_literals.end();
+    variable_state &vs = var_state[var];
+    bool was_unit = literal_true(lit);
+    bool was_bcp_unit = was_unit && vs.bcp;
     
-    if (unit_literals.find(-lit) != unit_literals.end()) {
+    if (literal_true(-lit)) {
 	// Conflict
 	trigger_conflict();
 	return;
@@ -676,65 +1239,136 @@ void Cnf::assign_literal(int lit, bool bcp) {
 	if (was_unit) {
 	    err(false, "Attempt to set literal %d by BCP that is already unit\n", lit);
 	} else {
-	    unit_literals.insert(lit);
-	    bcp_unit_literals.insert(lit);
-	    action_stack.push_back({ACTION_BCP, lit});
+	    vs.value = lit > 0 ? 1 : -1;
+	    vs.bcp = true;
+	    bcp_unit_count++;
+	    push_trail(var);
 	}
     } else {
 	if (was_unit && !was_bcp_unit) {
 	    err(false, "Attempt to assert literal %d that is already unit\n", lit);
 	} else {
 	    if (was_bcp_unit) {
-		bcp_unit_literals.erase(lit);
+		vs.bcp = false;
+		bcp_unit_count--;
 		action_stack.push_back({ACTION_ASSERT_FROM_BCP, lit});
 	    } else {
-		unit_literals.insert(lit);
-		action_stack.push_back({ACTION_ASSERT, lit});
+		vs.value = lit > 0 ? 1 : -1;
+		vs.bcp = false;
+		push_trail(var);
 	    }
 	}
     }
 }
 
-void Cnf::uquantify_variable(int var) {
-    uquantified_variables.insert(var);
-    action_stack.push_back({ACTION_UQUANTIFY, var});
+void Cnf::push_trail(int var) {
+    var_state[var].level = context_level;
+    trail.push_back(var);
+}
+
+void Cnf::get_bcp_units(std::vector<int> &units) {
+    units.clear();
+    for (int var : trail) {
+	variable_state &vs = var_state[var];
+	if (vs.bcp)
+	    units.push_back(vs.value * var);
+    }
 }
 
 void Cnf::activate_clause(int cid) {
+    active_clauses->insert(cid);
+    int offset = clause_offset[cid-1];
     int len = clause_length(cid);
+    active_literal_count += len;
     for (int lid = 0; lid < len; lid++) {
-	int lit = get_literal(cid, lid);
-	(*literal_clauses)[lit].insert(cid);
+	int lit = literal_sequence[offset+lid];
+	literal_clauses->add(lit, cid, offset+lid);
     }
-    active_clauses->insert(cid);
 }
 
-void Cnf::push_active(std::set<int> *nactive_clauses) {
-    active_stack.push_back({active_clauses,literal_clauses});
-    action_stack.push_back({ACTION_ACTIVE_CLAUSES,0});
-    active_clauses = nactive_clauses;
-    literal_clauses = new std::unordered_map<int,std::unordered_set<int>>;
-    for (int cid : *active_clauses) {
-	int len = clause_length(cid);
-	for (int lid = 0; lid < len; lid++) {
-	    int lit = get_literal(cid, lid);
-	    if (!skip_literal(lit))
-		(*literal_clauses)[lit].insert(cid);
+// Reclaim storage of inactive clauses and renumber the active ones, preserving their order.
+// Only possible when no context beyond the initial one is open.  Deactivations
+// within the initial context become permanent.
+void Cnf::collect_garbage(bool force) {
+    if (context_level > 1)
+	return;
+    int waste = literal_sequence.size() - active_literal_count;
+    if (!force && (waste < GC_MIN_WASTE || waste < GC_WASTE_FRACTION * literal_sequence.size()))
+	return;
+    int maxcid = maximum_clause_id();
+    std::vector<int> cid_map(maxcid+1, 0);
+    int ncid = 0;
+    int npos = 0;
+    int start = clause_offset[0];
+    for (int cid = 1; cid <= maxcid; cid++) {
+	int end = clause_offset[cid];
+	if (active_clauses->is_member(cid)) {
+	    // Move clause down.  New positions never exceed old ones
+	    ncid++;
+	    cid_map[cid] = ncid;
+	    for (int pos = start; pos < end; pos++) {
+		literal_clauses->move_position(pos, npos);
+		literal_sequence[npos++] = literal_sequence[pos];
+	    }
+	    clause_offset[ncid] = npos;
+	    clause_signature[ncid] = clause_signature[cid];
+	    watch_literals[2*ncid] = watch_literals[2*cid];
+	    watch_literals[2*ncid+1] = watch_literals[2*cid+1];
+	}
+	start = end;
+    }
+    clause_offset.resize(ncid+1);
+    literal_sequence.resize(npos);
+    clause_signature.resize(ncid+1);
+    watch_literals.resize(2*(ncid+1));
+    // Renumber clauses in sets and lists, keeping their order
+    active_clauses->clear();
+    for (int cid = 1; cid <= ncid; cid++)
+	active_clauses->insert(cid);
+    literal_clauses->renumber(cid_map);
+    for (std::vector<int> &wlist : watch_lists) {
+	int j = 0;
+	for (int cid : wlist) {
+	    if (cid_map[cid] > 0)
+		wlist[j++] = cid_map[cid];
+	}
+	wlist.resize(j);
+    }
+    int j = 0;
+    for (int cid : unwatched_clauses) {
+	if (cid_map[cid] > 0)
+	    unwatched_clauses[j++] = cid_map[cid];
+    }
+    unwatched_clauses.resize(j);
+    j = 0;
+    for (action_record ar : action_stack) {
+	if (ar.action == ACTION_DEACTIVATE_CLAUSE)
+	    // Clause no longer exists
+	    continue;
+	if (ar.action == ACTION_UNWATCHED_CLAUSE) {
+	    if (cid_map[ar.ele] == 0)
+		continue;
+	    ar.ele = cid_map[ar.ele];
 	}
+	action_stack[j++] = ar;
     }
+    action_stack.resize(j);
+    report(3, "Garbage collection reclaimed %d clauses and %d literals.  %d clauses remain\n",
+	   maxcid - ncid, waste, ncid);
 }
 
-
 // Mark clause for deactivation once iterator completes
 // Clause is no longer considered part of clausal state
 void Cnf::deactivate_clause(int cid) {
+    active_clauses->erase(cid);
+    action_stack.push_back({ACTION_DEACTIVATE_CLAUSE, cid});
+    int offset = clause_offset[cid-1];
     int len = clause_length(cid);
+    active_literal_count -= len;
     for (int lid = 0; lid < len; lid++) {
-	int lit = get_literal(cid, lid);
-	(*literal_clauses)[lit].erase(cid);
+	int lit = literal_sequence[offset+lid];
+	literal_clauses->remove(lit, cid, offset+lid);
     }
-    active_clauses->erase(cid);
-    action_stack.push_back({ACTION_DEACTIVATE_CLAUSE, cid});
 }
 
 void Cnf::deactivate_clauses(std::vector<int> &remove) {
@@ -743,22 +1377,17 @@ void Cnf::deactivate_clauses(std::vector<int> &remove) {
 }
 
 bool Cnf::skip_clause(int cid) {
+    int offset = clause_offset[cid-1];
     int len = clause_length(cid);
     for (int lid = 0; lid < len; lid++) {
-	int lit = get_literal(cid, lid);
-	if (unit_literals.find(lit) != unit_literals.end())
+	if (literal_true(literal_sequence[offset+lid]))
 	    return true;
     }
     return false;
 }
 
 bool Cnf::skip_literal(int lit) {
-    if  (unit_literals.find(-lit) != unit_literals.end())
-	return true;
-    int var = IABS(lit);
-    if (uquantified_variables.find(var) != uquantified_variables.end())
-	return true;
-    return false;
+    return literal_false(lit);
 }
 
 void Cnf::trigger_conflict() {
@@ -766,65 +1395,140 @@ void Cnf::trigger_conflict() {
     action_stack.push_back({ACTION_CONFLICT, 0});
 }
 
-// Return TAUTOLOGY, CONFLICT, propagated unit, or zero
-int Cnf::propagate_clause(int cid) {
-    int len = clause_length(cid);
-    int result = CONFLICT;
+int Cnf::watch_clause(int cid) {
+    int offset = clause_offset[cid-1];
+    int len = clause_offset[cid] - offset;
+    int wlits[2] = {0, 0};
+    int nfound = 0;
     for (int lid = 0; lid < len; lid++) {
-	int lit = get_literal(cid, lid);
-	if (unit_literals.find(lit) != unit_literals.end()) {
-	    result = TAUTOLOGY;
-	    break;
+	int lit = literal_sequence[offset+lid];
+	if (literal_true(lit))
+	    return TAUTOLOGY;
+	if (literal_false(lit))
+	    continue;
+	if (nfound < 2)
+	    wlits[nfound] = lit;
+	nfound++;
+    }
+    if (nfound == 0)
+	return CONFLICT;
+    if (nfound == 1)
+	return wlits[0];
+    int *cwlits = &watch_literals[2*cid];
+    for (int w = 0; w < 2; w++) {
+	int lit = wlits[w];
+	if (lit != cwlits[0] && lit != cwlits[1])
+	    watch_lists[LCODE(lit)].push_back(cid);
+    }
+    cwlits[0] = wlits[0];
+    cwlits[1] = wlits[1];
+    return 0;
+}
+
+int Cnf::propagate_false(int flit, bool preprocess) {
+    int count = 0;
+    std::vector<int> &wlist = watch_lists[LCODE(flit)];
+    int j = 0;
+    for (int i = 0; i < wlist.size(); i++) {
+	int cid = wlist[i];
+	int *wlits = &watch_literals[2*cid];
+	if (wlits[0] != flit && wlits[1] != flit)
+	    // Stale entry
+	    continue;
+	wlist[j++] = cid;
+	if (has_conflict || !active_clauses->is_member(cid))
+	    continue;
+	// Keep false literal in second position
+	if (wlits[0] == flit) {
+	    wlits[0] = wlits[1];
+	    wlits[1] = flit;
 	}
-	if (skip_literal(lit))
+	int olit = wlits[0];
+	if (literal_true(olit))
 	    continue;
-	if (result == CONFLICT)
-	    result = lit;
-	else
-	    result = 0;
+	// Look for replacement watch
+	int offset = clause_offset[cid-1];
+	int len = clause_offset[cid] - offset;
+	int nlit = 0;
+	for (int lid = 0; lid < len; lid++) {
+	    int lit = literal_sequence[offset+lid];
+	    if (lit != olit && lit != flit && !literal_false(lit)) {
+		nlit = lit;
+		break;
+	    }
+	}
+	if (nlit != 0) {
+	    wlits[1] = nlit;
+	    watch_lists[LCODE(nlit)].push_back(cid);
+	    j--;
+	} else if (literal_false(olit))
+	    trigger_conflict();
+	else {
+	    if (preprocess)
+		set_variable_type(IABS(olit), VAR_ELIM);
+	    assign_literal(olit, true);
+	    count++;
+	}
     }
-    return result;
+    wlist.resize(j);
+    return count;
 }
 
-
 int Cnf::bcp(bool preprocess) {
-    unique_queue<int> clause_queue(active_clauses);
     int count = 0;
-    while (!has_conflict && !clause_queue.empty()) {
-	int cid = clause_queue.get_and_pop();
-	if (active_clauses->find(cid) == active_clauses->end())
-	    continue;
-	int rval = propagate_clause(cid);
+    // Examine clauses whose watches can't be trusted
+    while (!has_conflict && unwatched_clauses.size() > 0) {
+	int cid = unwatched_clauses.back();
+	unwatched_clauses.pop_back();
+	int rval = 0;
+	if (active_clauses->is_member(cid)) {
+	    rval = watch_clause(cid);
+	    if (rval == 0)
+		continue;
+	}
+	// Examine again after backtracking
+	action_stack.push_back({ACTION_UNWATCHED_CLAUSE, cid});
 	if (rval == CONFLICT)
 	    trigger_conflict();
-	else if (rval == 0)
-	    continue;
 	else if (rval == TAUTOLOGY)
 	    deactivate_clause(cid);
-	else {
-	    int lit = rval;
-	    int var = IABS(lit);
+	else if (rval != 0) {
 	    if (preprocess)
-		set_variable_type(var, VAR_ELIM);
-	    std::vector<int> remove;
-	    assign_literal(lit, true);
-	    deactivate_clause(cid);
-	    for (int ocid : (*literal_clauses)[lit]) {
-		if (active_clauses->find(ocid) != active_clauses->end())
-		    remove.push_back(ocid);
-	    }
-	    deactivate_clauses(remove);
-	    if (literal_clauses->find(-lit) != literal_clauses->end()) {
-		for (int ocid : (*literal_clauses)[-lit])
-		    if (active_clauses->find(ocid) != active_clauses->end())
-			clause_queue.push(ocid);
-	    }
+		set_variable_type(IABS(rval), VAR_ELIM);
+	    assign_literal(rval, true);
 	    count++;
 	}
     }
+    // Process new assignments
+    while (!has_conflict && trail_head < trail.size()) {
+	int var = trail[trail_head++];
+	int tlit = var_state[var].value * var;
+	// Clauses containing true literal are satisfied.
+	// Copy, since deactivation can modify the occurrence list
+	satisfied_clauses.clear();
+	for (int cid : (*literal_clauses)[tlit]) {
+	    if (active_clauses->is_member(cid))
+		satisfied_clauses.push_back(cid);
+	}
+	deactivate_clauses(satisfied_clauses);
+	count += propagate_false(-tlit, preprocess);
+    }
     return count;
 }
 
+int Cnf::new_variable() {
+    nvar++;
+    variable_type.push_back(VAR_UNUSED);
+    var_state.push_back({0, false, 0});
+    literal_clauses->resize(nvar);
+    watch_lists.resize(2*(nvar+1));
+    bve_queue.resize(nvar);
+    scratch.resize(nvar);
+    if (oracle.solver)
+	oracle.resize(nvar);
+    return nvar;
+}
+
 void Cnf::set_variable_type(int var, var_t type) {
     if (var <= 0 || var > nvar)
 	err(true, "Attempted to set type of variable %d to %d\n", var, (int) type);
@@ -889,7 +1593,9 @@ bool Cnf::check_simple_pkc(std::vector<int> &clause_chunks) {
 	return ok;
     }
     if (ok) {
-	for (int lit : bcp_unit_literals) {
+	std::vector<int> units;
+	get_bcp_units(units);
+	for (int lit : units) {
 	    if (!is_data_variable(IABS(lit)))
 		continue;
 	    clause_chunks.push_back(lit);
@@ -931,52 +1637,420 @@ int Cnf::find_split(bool defer) {
 ///// Support for bounded variable elimination
 
 int Cnf::resolve(int var, int cid1, int cid2) {
-    // Merge two sets of literals
-    std::vector<int> mlits;
-    int len1 = clause_length(cid1);
-    for (int lid1 = 0; lid1 < len1; lid1++) {
-	int lit1 = get_literal(cid1, lid1);
-	int var1 = IABS(lit1);
-	if (var1 == var)
+    std::vector<int> nlits;
+    if (!resolvent(var, cid1, cid2, &nlits, scratch))
+	return 0;
+    int cid = new_clause();
+    for (int lit : nlits)
+	add_literal(lit);
+    report(5, "Resolving clauses %d and %d (variable %d) yields clause %d\n", cid1, cid2, var, cid);
+    return cid;
+}
+
+// Each literal added to the resolvent stamps its variable with the current stamp, signed by
+// the literal's phase.  Duplicate and complementary literals are thereby detected without sorting
+bool Cnf::resolvent(int var, int cid1, int cid2, std::vector<int> *nlits, resolve_scratch &rs) {
+    if (++rs.resolve_stamp == INT_MAX) {
+	std::fill(rs.variable_stamp.begin(), rs.variable_stamp.end(), 0);
+	rs.resolve_stamp = 1;
+    }
+    if (nlits)
+	nlits->clear();
+    // Number of occurrences of the resolution variable.  More than two indicates a tautological clause
+    int vcount = 0;
+    for (int i = 0; i < 2; i++) {
+	int cid = i == 0 ? cid1 : cid2;
+	int offset = clause_offset[cid-1];
+	int len = clause_offset[cid] - offset;
+	for (int lid = 0; lid < len; lid++) {
+	    int lit = literal_sequence[offset+lid];
+	    int lvar = IABS(lit);
+	    if (lvar == var) {
+		vcount++;
+		continue;
+	    }
+	    if (skip_literal(lit))
+		continue;
+	    int stamp = lit > 0 ? rs.resolve_stamp : -rs.resolve_stamp;
+	    if (rs.variable_stamp[lvar] == stamp)
+		// Duplicate
+		continue;
+	    if (rs.variable_stamp[lvar] == -stamp) {
+		report(5, "Resolving clauses %d and %d (variable %d) yields tautology\n", cid1, cid2, var);
+		return false;
+	    }
+	    rs.variable_stamp[lvar] = stamp;
+	    if (nlits)
+		nlits->push_back(lit);
+	}
+    }
+    if (vcount > 2) {
+	report(5, "Resolving clauses %d and %d (variable %d) yields tautology\n", cid1, cid2, var);
+	return false;
+    }
+    return true;
+}
+
+int Cnf::count_resolvents(int var, std::vector<int> &pairs, resolve_scratch &rs) {
+    int count = 0;
+    for (int i = 0; i < pairs.size(); i += 2) {
+	if (resolvent(var, pairs[i], pairs[i+1], NULL, rs))
+	    count++;
+    }
+    return count;
+}
+
+// Subsumption checks mark the literals of the new clause
+void Cnf::mark_literals(std::vector<int> &lits, bool value, resolve_scratch &rs) {
+    for (int lit : lits)
+	rs.literal_mark[LCODE(lit)] = value;
+}
+
+bool Cnf::forward_subsume(std::vector<int> &lits, int &strengthen_count, resolve_scratch &rs) {
+    uint64_t sig = 0;
+    for (int lit : lits)
+	sig |= literal_signature(lit);
+    mark_literals(lits, true, rs);
+    bool subsumed = false;
+    int i = 0;
+    while (!subsumed && i < lits.size()) {
+	int lit = lits[i];
+	if ((*literal_clauses)[lit].size() > SUBSUME_MAX_OCCURRENCE || (*literal_clauses)[-lit].size() > SUBSUME_MAX_OCCURRENCE) {
+	    i++;
 	    continue;
-	if (skip_literal(lit1))
+	}
+	// Look for clause that subsumes new one
+	for (int cid : (*literal_clauses)[lit]) {
+	    if (clause_signature[cid] & ~sig)
+		continue;
+	    int offset = clause_offset[cid-1];
+	    int len = clause_offset[cid] - offset;
+	    bool subset = true;
+	    for (int lid = 0; subset && lid < len; lid++) {
+		int clit = literal_sequence[offset+lid];
+		subset = rs.literal_mark[LCODE(clit)] || skip_literal(clit);
+	    }
+	    if (subset) {
+		subsumed = true;
+		break;
+	    }
+	}
+	if (subsumed)
+	    break;
+	// Look for clause that resolves with new one on this literal to give subset of new one
+	bool strengthen = false;
+	for (int cid : (*literal_clauses)[-lit]) {
+	    if (clause_signature[cid] & ~(sig | literal_signature(-lit)))
+		continue;
+	    int offset = clause_offset[cid-1];
+	    int len = clause_offset[cid] - offset;
+	    bool subset = true;
+	    for (int lid = 0; subset && lid < len; lid++) {
+		int clit = literal_sequence[offset+lid];
+		// Tautological clause can't strengthen
+		subset = clit != lit && (clit == -lit || rs.literal_mark[LCODE(clit)] || skip_literal(clit));
+	    }
+	    if (subset) {
+		strengthen = true;
+		break;
+	    }
+	}
+	if (strengthen) {
+	    rs.literal_mark[LCODE(lit)] = false;
+	    lits.erase(lits.begin() + i);
+	    sig = 0;
+	    for (int slit : lits)
+		sig |= literal_signature(slit);
+	    strengthen_count++;
+	} else
+	    i++;
+    }
+    mark_literals(lits, false, rs);
+    return subsumed;
+}
+
+int Cnf::backward_subsume(int ncid, int var, std::unordered_set<int> &change_variables, int &strengthen_count) {
+    std::vector<int> lits;
+    int len = clause_length(ncid);
+    for (int lid = 0; lid < len; lid++)
+	lits.push_back(get_literal(ncid, lid));
+    if (len == 0)
+	return 0;
+    uint64_t sig = clause_signature[ncid];
+    mark_literals(lits, true, scratch);
+    // Clauses to remove, and those to replace by strengthened versions, along with literal to remove
+    std::vector<int> subsumed_clauses;
+    std::vector<int> strengthen_clauses;
+    std::vector<int> strengthen_literals;
+    // Any clause subsumed by the new one contains its least frequent literal.
+    // Any clause it strengthens contains the negation of one of its literals
+    int minlit = lits[0];
+    for (int lit : lits) {
+	if ((*literal_clauses)[lit].size() < (*literal_clauses)[minlit].size())
+	    minlit = lit;
+    }
+    for (int i = 0; i <= len; i++) {
+	int plit = i < len ? -lits[i] : minlit;
+	uint64_t psig = i < len ? literal_signature(lits[i]) : 0;
+	if ((*literal_clauses)[plit].size() > SUBSUME_MAX_OCCURRENCE)
 	    continue;
-	mlits.push_back(lit1);
+	for (int cid : (*literal_clauses)[plit]) {
+	    if (cid == ncid)
+		continue;
+	    if (sig & ~(clause_signature[cid] | psig))
+		continue;
+	    int offset = clause_offset[cid-1];
+	    int clen = clause_offset[cid] - offset;
+	    if (clen < len)
+		continue;
+	    // Count literals of new clause contained in this one
+	    int count = 0;
+	    bool has_var = false;
+	    bool tautology = false;
+	    for (int lid = 0; lid < clen; lid++) {
+		int clit = literal_sequence[offset+lid];
+		if (scratch.literal_mark[LCODE(clit)])
+		    count++;
+		if (IABS(clit) == var)
+		    has_var = true;
+		if (i < len && clit == lits[i])
+		    tautology = true;
+	    }
+	    // Clauses containing the eliminated variable will be deprecated
+	    if (has_var || tautology || skip_clause(cid))
+		continue;
+	    if (i == len && count == len)
+		subsumed_clauses.push_back(cid);
+	    else if (i < len && count == len-1) {
+		strengthen_clauses.push_back(cid);
+		strengthen_literals.push_back(plit);
+	    }
+	}
+    }
+    mark_literals(lits, false, scratch);
+    int subsume_count = 0;
+    for (int cid : subsumed_clauses) {
+	note_change_variables(cid, var, change_variables);
+	deactivate_clause(cid);
+	subsume_count++;
+	report(5, "Clause %d subsumes clause %d\n", ncid, cid);
     }
-    int len2 = clause_length(cid2);
-    for (int lid2 = 0; lid2 < len2; lid2++) {
-	int lit2 = get_literal(cid2, lid2);
-	int var2 = IABS(lit2);
-	if (var2 == var)
+    for (int i = 0; i < strengthen_clauses.size(); i++) {
+	int cid = strengthen_clauses[i];
+	if (!active_clauses->is_member(cid))
 	    continue;
-	if (skip_literal(lit2))
+	note_change_variables(cid, var, change_variables);
+	int scid = new_clause();
+	int clen = clause_length(cid);
+	for (int lid = 0; lid < clen; lid++) {
+	    int clit = get_literal(cid, lid);
+	    if (clit != strengthen_literals[i])
+		add_literal(clit);
+	}
+	deactivate_clause(cid);
+	strengthen_count++;
+	report(5, "Clause %d strengthens clause %d to give clause %d\n", ncid, cid, scid);
+    }
+    return subsume_count;
+}
+
+void Cnf::note_change_variables(int cid, int var, std::unordered_set<int> &change_variables) {
+    int len = clause_length(cid);
+    for (int lid = 0; lid < len; lid++) {
+	int clit = get_literal(cid, lid);
+	int cvar = IABS(clit);
+	if (cvar != var && !skip_literal(clit) && !is_data_variable(cvar))
+	    change_variables.insert(cvar);
+    }
+}
+
+bool Cnf::ternary_literals(int cid, int *lits) {
+    int count = 0;
+    int len = clause_length(cid);
+    for (int lid = 0; lid < len; lid++) {
+	int clit = get_literal(cid, lid);
+	if (literal_true(clit))
+	    return false;
+	if (skip_literal(clit))
 	    continue;
-	mlits.push_back(lit2);
+	if (count == 3)
+	    return false;
+	lits[count++] = clit;
     }
-    std::sort(mlits.begin(), mlits.end(), abs_less);
-    int last_lit = 0;
-    // Generate literals for resolvent
-    std::vector<int> nlits;
-    for (int lit : mlits) {
-	if (lit == last_lit)
+    return count == 3 && IABS(lits[0]) != IABS(lits[1]) && IABS(lits[0]) != IABS(lits[2]) && IABS(lits[1]) != IABS(lits[2]);
+}
+
+int Cnf::find_ternary(int lit1, int lit2, int lit3) {
+    // Scan shortest occurrence list
+    int slit = lit1;
+    if ((*literal_clauses)[lit2].size() < (*literal_clauses)[slit].size())
+	slit = lit2;
+    if ((*literal_clauses)[lit3].size() < (*literal_clauses)[slit].size())
+	slit = lit3;
+    int lits[3];
+    for (int cid : (*literal_clauses)[slit]) {
+	if (!ternary_literals(cid, lits))
 	    continue;
-	if (lit == -last_lit) {
-	    // Tautology
-	    report(5, "Resolving clauses %d and %d (variable %d) yields tautology\n", cid1, cid2, var);
-	    return 0;
+	bool match = true;
+	for (int lit : {lit1, lit2, lit3})
+	    match = match && (lits[0] == lit || lits[1] == lit || lits[2] == lit);
+	if (match)
+	    return cid;
+    }
+    return 0;
+}
+
+// Gate clauses have two properties: resolving any two of them on the variable yields a tautology,
+// and with the variable removed, they are unsatisfiable.  Then only resolvents between gate and
+// non-gate clauses are required
+bool Cnf::find_gate(int var, std::vector<int> &gate_clauses, resolve_scratch &rs) {
+    gate_clauses.clear();
+    // AND/OR: clause (lit | -a1 | ... | -ak) plus binary clauses (-lit | ai)
+    for (int phase = 0; phase <= 1; phase++) {
+	int lit = (2*phase - 1) * var;
+	std::vector<int> partners;
+	for (int cid : (*literal_clauses)[-lit]) {
+	    int olit = 0;
+	    int count = 0;
+	    int len = clause_length(cid);
+	    for (int lid = 0; lid < len; lid++) {
+		int clit = get_literal(cid, lid);
+		if (literal_true(clit)) {
+		    count = 0;
+		    break;
+		}
+		if (skip_literal(clit) || clit == -lit)
+		    continue;
+		olit = clit;
+		count++;
+	    }
+	    if (count == 1 && IABS(olit) != var && rs.gate_binary[LCODE(olit)] == 0) {
+		rs.gate_binary[LCODE(olit)] = cid;
+		partners.push_back(olit);
+	    }
+	}
+	if (partners.size() > 0) {
+	    for (int cid : (*literal_clauses)[lit]) {
+		bool found = true;
+		int count = 0;
+		int len = clause_length(cid);
+		for (int lid = 0; found && lid < len; lid++) {
+		    int clit = get_literal(cid, lid);
+		    if (clit == lit || skip_literal(clit))
+			continue;
+		    found = IABS(clit) != var && !literal_true(clit) && rs.gate_binary[LCODE(-clit)] != 0;
+		    count++;
+		}
+		if (found && count > 0) {
+		    gate_clauses.push_back(cid);
+		    for (int lid = 0; lid < len; lid++) {
+			int clit = get_literal(cid, lid);
+			if (clit != lit && !skip_literal(clit))
+			    gate_clauses.push_back(rs.gate_binary[LCODE(-clit)]);
+		    }
+		    break;
+		}
+	    }
+	}
+	for (int olit : partners)
+	    rs.gate_binary[LCODE(olit)] = 0;
+	if (gate_clauses.size() > 0) {
+	    report(4, "Variable %d defined by %s gate with %d inputs\n", var, phase == 1 ? "AND" : "OR", (int) gate_clauses.size() - 1);
+	    break;
 	}
-	nlits.push_back(lit);
-	last_lit = lit;
     }
-    int cid = new_clause();
-    for (int lit : nlits)
-	add_literal(lit);
-    report(5, "Resolving clauses %d and %d (variable %d) yields clause %d\n", cid1, cid2, var, cid);
-    return cid;
+    // Searches for XOR and ITE gates can take quadratic time
+    bool search_ternary = (*literal_clauses)[var].size() + (*literal_clauses)[-var].size() <= GATE_MAX_OCCURRENCE;
+    if (search_ternary && gate_clauses.size() == 0) {
+	// XOR: (var | a | b), (var | -a | -b), (-var | -a | b), (-var | a | -b)
+	int lits[3];
+	for (int cid : (*literal_clauses)[var]) {
+	    if (!ternary_literals(cid, lits))
+		continue;
+	    int a = lits[0] == var ? lits[1] : lits[0];
+	    int b = lits[2] == var ? lits[1] : lits[2];
+	    int cid2 = find_ternary(var, -a, -b);
+	    int cid3 = cid2 == 0 ? 0 : find_ternary(-var, -a, b);
+	    int cid4 = cid3 == 0 ? 0 : find_ternary(-var, a, -b);
+	    if (cid4 != 0) {
+		gate_clauses = {cid, cid2, cid3, cid4};
+		report(4, "Variable %d defined by XOR gate\n", var);
+		break;
+	    }
+	}
+    }
+    if (search_ternary && gate_clauses.size() == 0) {
+	// ITE: (-var | -c | t), (-var | c | e), (var | -c | -t), (var | c | -e)
+	int lits[3];
+	int elits[3];
+	for (int cid : (*literal_clauses)[-var]) {
+	    if (!ternary_literals(cid, lits))
+		continue;
+	    int olits[2];
+	    int ocount = 0;
+	    for (int i = 0; i < 3; i++)
+		if (lits[i] != -var)
+		    olits[ocount++] = lits[i];
+	    for (int i = 0; gate_clauses.size() == 0 && i < 2; i++) {
+		int c = -olits[i];
+		int t = olits[1-i];
+		int cid3 = find_ternary(var, -c, -t);
+		if (cid3 == 0)
+		    continue;
+		// Look for second clause containing -var and c
+		int slit = (*literal_clauses)[c].size() < (*literal_clauses)[-var].size() ? c : -var;
+		for (int cid2 : (*literal_clauses)[slit]) {
+		    if (cid2 == cid || !ternary_literals(cid2, elits))
+			continue;
+		    int e = 0;
+		    bool has_var = false;
+		    bool has_c = false;
+		    for (int j = 0; j < 3; j++) {
+			if (elits[j] == -var)
+			    has_var = true;
+			else if (elits[j] == c)
+			    has_c = true;
+			else
+			    e = elits[j];
+		    }
+		    if (!has_var || !has_c)
+			continue;
+		    int cid4 = find_ternary(var, c, -e);
+		    if (cid4 != 0) {
+			gate_clauses = {cid, cid2, cid3, cid4};
+			report(4, "Variable %d defined by ITE gate\n", var);
+			break;
+		    }
+		}
+	    }
+	    if (gate_clauses.size() > 0)
+		break;
+	}
+    }
+    std::sort(gate_clauses.begin(), gate_clauses.end());
+    gate_clauses.erase(std::unique(gate_clauses.begin(), gate_clauses.end()), gate_clauses.end());
+    return gate_clauses.size() > 0;
+}
+
+bool Cnf::bve_candidate(int var, int maxdegree, int &cost, std::vector<int> &gate_clauses, resolve_scratch &rs) {
+    int dpos = (*literal_clauses)[var].size();
+    int dneg = (*literal_clauses)[-var].size();
+    gate_clauses.clear();
+    if (maxdegree >= GATE_MIN_DEGREE && dpos + dneg <= GATE_MAX_OCCURRENCE && find_gate(var, gate_clauses, rs)) {
+	int gpos = 0;
+	for (int cid : (*literal_clauses)[var])
+	    if (std::binary_search(gate_clauses.begin(), gate_clauses.end(), cid))
+		gpos++;
+	int gneg = gate_clauses.size() - gpos;
+	cost = gpos * (dneg - gneg) + (dpos - gpos) * gneg - dpos - dneg;
+	return true;
+    }
+    cost = dpos * dneg - dpos - dneg;
+    return IMIN(dpos, dneg) <= maxdegree;
 }
 
 #if RANDOM_BVE
-int Cnf::bve(bool preprocess, int maxdegree) {
+int Cnf::bve(bool preprocess, int maxdegree, int nthreads) {
     // Limit on number of added claues.  Based on number when have balanced elimination
     int maxadded = maxdegree*maxdegree - 2*maxdegree;
     // Projection variables
@@ -1085,7 +2159,7 @@ int Cnf::bve(bool preprocess, int maxdegree) {
 		report(5, "Projection variable %d.  Degree = %d\n", ovar, odegree);
 	    }
 	}
-	if (degree == 0 && bcp_unit_literals.find(-lit) == bcp_unit_literals.end())
+	if (degree == 0 && !(literal_true(-lit) && var_state[var].bcp))
 	    // Pure literal
 	    assign_literal(-lit, true);
 	report(3, "BVE on variable %d deprecated %d clauses and added %d new ones\n", var, deprecated_clause_count, new_clause_count);
@@ -1093,23 +2167,180 @@ int Cnf::bve(bool preprocess, int maxdegree) {
 	    incr_count_by(COUNT_BVE_ELIM_CLAUSE, deprecated_clause_count);
 	    incr_count_by(COUNT_BVE_NEW_CLAUSE, new_clause_count);
 	}
+	collect_garbage(false);
     }
     return eliminated_count;
 }
 #endif // RANDOM_BVE
 
 #if !RANDOM_BVE
-int Cnf::bve(bool preprocess, int maxdegree) {
+bool Cnf::bve_plan_elimination(int var, int maxdegree, bve_plan &plan, resolve_scratch &rs) {
+    // Limit on number of added claues.  Based on number when have balanced elimination
+    int maxadded = maxdegree*maxdegree - 2*maxdegree;
+    int dpos = (*literal_clauses)[var].size();
+    int dneg = (*literal_clauses)[-var].size();
+    int lit = dpos <= dneg ? var : -var;  // Literal with lower degree
+    int deprecated_clause_count =  dpos + dneg;
+    plan.var = var;
+    plan.lit = lit;
+    plan.occurrences.assign((*literal_clauses)[var].begin(), (*literal_clauses)[var].end());
+    plan.occurrences.insert(plan.occurrences.end(), (*literal_clauses)[-var].begin(), (*literal_clauses)[-var].end());
+    plan.accept = false;
+    int strengthen_count = 0;
+    // With gate definition, only need resolve gate clauses against non-gate clauses
+    int cost;
+    std::vector<int> &gate_clauses = plan.gate_clauses;
+    bve_candidate(var, maxdegree, cost, gate_clauses, rs);
+    plan.pairs.clear();
+    for (int cid1 : (*literal_clauses)[lit]) {
+	bool gate1 = std::binary_search(gate_clauses.begin(), gate_clauses.end(), cid1);
+	for (int cid2 : (*literal_clauses)[-lit]) {
+	    if (gate_clauses.size() > 0 && gate1 == std::binary_search(gate_clauses.begin(), gate_clauses.end(), cid2))
+		continue;
+	    plan.pairs.push_back(cid1);
+	    plan.pairs.push_back(cid2);
+	}
+    }
+    std::vector<int> &pairs = plan.pairs;
+    std::vector<int> &rlits = plan.rlits;
+    // Count nontautological resolvents without generating them
+    int resolvent_count = count_resolvents(var, pairs, rs);
+    if (resolvent_count - deprecated_clause_count > maxadded) {
+	// Resolvents subsumed by existing clauses don't count against limit.
+	// Check them, stopping once the limit is exceeded
+	int count = 0;
+	for (int i = 0; i < pairs.size() && count - deprecated_clause_count <= maxadded; i += 2) {
+	    if (!resolvent(var, pairs[i], pairs[i+1], &rlits, rs))
+		continue;
+	    if (!forward_subsume(rlits, strengthen_count, rs))
+		count++;
+	}
+	if (count - deprecated_clause_count > maxadded) {
+	    // Skip.  Would generate too many clauses
+	    report(5, "BVE on variable %d would generate %d clauses.  Skipping\n", var, resolvent_count);
+	    return false;
+	}
+    }
+    // Generate resolvents, omitting those subsumed by existing clauses
+    plan.resolvent_literals.clear();
+    plan.resolvent_start.clear();
+    for (int i = 0; i < pairs.size(); i += 2) {
+	if (!resolvent(var, pairs[i], pairs[i+1], &rlits, rs))
+	    continue;
+	if (forward_subsume(rlits, strengthen_count, rs))
+	    continue;
+	plan.resolvent_start.push_back(plan.resolvent_literals.size());
+	plan.resolvent_literals.insert(plan.resolvent_literals.end(), rlits.begin(), rlits.end());
+    }
+    plan.resolvent_start.push_back(plan.resolvent_literals.size());
+    plan.accept = true;
+    return true;
+}
+
+bool Cnf::bve_plan_current(bve_plan &plan) {
+    std::vector<int> &pos = (*literal_clauses)[plan.var];
+    std::vector<int> &neg = (*literal_clauses)[-plan.var];
+    return plan.occurrences.size() == pos.size() + neg.size()
+	&& std::equal(pos.begin(), pos.end(), plan.occurrences.begin())
+	&& std::equal(neg.begin(), neg.end(), plan.occurrences.begin() + pos.size());
+}
+
+void Cnf::bve_eliminate(bve_plan &plan, bool preprocess, int maxdegree, std::unordered_set<int> &eliminated_variables) {
+    int var = plan.var;
+    int lit = plan.lit;
+    int degree = IMIN((*literal_clauses)[var].size(), (*literal_clauses)[-var].size());
+    int deprecated_clause_count = plan.occurrences.size();
+    int resolvent_count = plan.resolvent_start.size() - 1;
+    std::vector<int> &resolvent_start = plan.resolvent_start;
+    int new_clause_count = 0;
+    int strengthen_count = 0;
+    eliminated_variables.insert(var);
+    if (preprocess)
+	set_variable_type(var, VAR_ELIM);
+    std::unordered_set<int>change_variables;
+    std::vector<int>deprecate_clauses;
+    for (int cid1 : (*literal_clauses)[lit]) {
+	deprecate_clauses.push_back(cid1);
+	int len1 = clause_length(cid1);
+	for (int lid1 = 0; lid1 < len1; lid1++) {
+	    int lit1 = get_literal(cid1, lid1);
+	    if (skip_literal(lit1))
+		continue;
+	    if (lit1 == lit)
+		continue;
+	    int var1 = IABS(lit1);
+	    if (is_data_variable(var1))
+		continue;
+	    change_variables.insert(var1);
+	}
+    }
+    for (int cid2 : (*literal_clauses)[-lit]) {
+	deprecate_clauses.push_back(cid2);
+	int len2 = clause_length(cid2);
+	for (int lid2 = 0; lid2 < len2; lid2++) {
+	    int lit2 = get_literal(cid2, lid2);
+	    if (skip_literal(lit2))
+		continue;
+	    if (lit2 == -lit)
+		continue;
+	    int var2 = IABS(lit2);
+	    if (is_data_variable(var2))
+		continue;
+	    change_variables.insert(var2);
+	}
+    }
+    int backward_count = 0;
+    // Add longer resolvents first, so that those subsumed by later ones get removed
+    plan.resolvent_order.clear();
+    for (int r = 0; r < resolvent_count; r++)
+	plan.resolvent_order.push_back(r);
+    std::stable_sort(plan.resolvent_order.begin(), plan.resolvent_order.end(),
+		     [&resolvent_start](int r1, int r2) {
+			 return resolvent_start[r1+1] - resolvent_start[r1] > resolvent_start[r2+1] - resolvent_start[r2]; });
+    for (int r : plan.resolvent_order) {
+	int ncid = new_clause();
+	for (int pos = resolvent_start[r]; pos < resolvent_start[r+1]; pos++)
+	    add_literal(plan.resolvent_literals[pos]);
+	new_clause_count++;
+	backward_count += backward_subsume(ncid, var, change_variables, strengthen_count);
+    }
+    deactivate_clauses(deprecate_clauses);
+    // Occurrence counts have changed only for variables in deprecated, subsumed, and strengthened clauses
+    for (int ovar : change_variables) {
+	if (eliminated_variables.find(ovar) != eliminated_variables.end())
+	    continue;
+	int ocost;
+	if (bve_candidate(ovar, maxdegree, ocost, scratch.gate_clauses, scratch)) {
+	    bve_queue.update(ovar, ocost);
+	    report(5, "Projection variable %d.  Cost = %d\n", ovar, ocost);
+	} else
+	    bve_queue.remove(ovar);
+    }
+    if (degree == 0 && !(literal_true(-lit) && var_state[var].bcp))
+	// Pure literal
+	assign_literal(-lit, true);
+    report(3, "BVE on variable %d deprecated %d clauses and added %d new ones\n", var, deprecated_clause_count, new_clause_count);
+    if (backward_count + strengthen_count > 0)
+	report(3, "BVE on variable %d: %d clauses subsumed, %d clauses strengthened\n",
+	       var, backward_count, strengthen_count);
+    if (preprocess) {
+	incr_count_by(COUNT_BVE_ELIM_CLAUSE, deprecated_clause_count);
+	incr_count_by(COUNT_BVE_NEW_CLAUSE, new_clause_count);
+	incr_count_by(COUNT_BVE_SUBSUME_CLAUSE, backward_count);
+	incr_count_by(COUNT_BVE_STRENGTHEN_CLAUSE, strengthen_count);
+	if (plan.gate_clauses.size() > 0)
+	    incr_count(COUNT_BVE_GATE_VAR);
+    }
+}
+
+int Cnf::bve(bool preprocess, int maxdegree, int nthreads) {
     // Limit on number of added claues.  Based on number when have balanced elimination
     int maxadded = maxdegree*maxdegree - 2*maxdegree;
     // Projection variables
     std::unordered_set<int> proj_variables;
-    // Variables with sufficiently low degree
-#if STACK_BVE
-    std::vector<int> degree_variables[maxdegree+1];
-#else
-    std::unordered_set<int> degree_variables[maxdegree+1];
-#endif
+    // Variables with sufficiently low degree, ordered by resolvent cost
+    bve_queue.clear();
+    long start_operations = bve_queue.operations();
     // Eliminated variables
     std::unordered_set<int> eliminated_variables;
     for (int cid: *active_clauses) {
@@ -1124,131 +2355,108 @@ int Cnf::bve(bool preprocess, int maxdegree) {
 	    if (proj_variables.find(var) != proj_variables.end())
 		continue;
 	    proj_variables.insert(var);
-	    int degree = IMIN((*literal_clauses)[lit].size(), (*literal_clauses)[-lit].size());;
- 	    if (degree <= maxdegree)
-#if STACK_BVE
-		degree_variables[degree].push_back(var);
-#else
-		degree_variables[degree].insert(var);
-#endif
-	    report(5, "Projection variable %d.  Degree = %d\n", var, degree);
+	    int cost;
+	    if (bve_candidate(var, maxdegree, cost, scratch.gate_clauses, scratch))
+		bve_queue.update(var, cost);
+	    report(5, "Projection variable %d.  Degree = %d\n", var,
+		   (int) IMIN((*literal_clauses)[var].size(), (*literal_clauses)[-var].size()));
 	}
     }
-    // Iteratively eliminate variables where one literal is of low degree
-    while (true) {
-	int var = 0;
-	int lit = 0;  // Literal with lower degree
-	int degree = 0;
-	// Find variable contained in fewest number of clauses for some phase
-	for (int d = 0; var == 0 && d <= maxdegree; d++) {
-#if STACK_BVE
-	    while (degree_variables[d].size() > 0) {
-		int dvar = degree_variables[d].back();
-		degree_variables[d].pop_back();
-		int dpos = (*literal_clauses)[dvar].size();
-		int dneg = (*literal_clauses)[-dvar].size();
-		if (eliminated_variables.find(dvar) == eliminated_variables.end() 
-		    && (dpos == d ||dneg == d)) {
-		    var = dvar;
-		    lit = dpos <= dneg ? var : -var;
-		    degree = d;
-		    break;
+    // Select batches of variables with lowest cost, such that no two have clauses with a variable in common.
+    // Plan eliminations concurrently, and then perform them in order of selection.
+    // The same batches are used for any number of threads, and so the result does not depend on it
+    int nworkers = nthreads <= 1 ? 1 : nthreads;
+    std::vector<resolve_scratch> thread_scratch(nworkers > 1 ? nworkers : 0);
+    for (resolve_scratch &rs : thread_scratch)
+	rs.initialize(nvar);
+    std::vector<bve_plan> plans(BVE_BATCH_SIZE);
+    std::vector<int> batch;
+    // Variables passed over for current batch, and their costs
+    std::vector<int> deferred_variables;
+    std::vector<int> deferred_costs;
+    // For each variable, 1 + index of batch variable having it in a clause, or 0
+    std::vector<int> &neighbor_owner = bve_neighbor_owner;
+    neighbor_owner.resize(nvar+1, 0);
+    std::vector<int> neighbors;
+    while (!bve_queue.empty()) {
+	batch.clear();
+	deferred_variables.clear();
+	deferred_costs.clear();
+	while (!bve_queue.empty() && batch.size() < BVE_BATCH_SIZE && deferred_variables.size() < BVE_BATCH_SIZE) {
+	    if (bve_queue.top_cost() > maxadded + BVE_COST_SLACK)
+		// Remaining variables would generate too many clauses
+		break;
+	    int cost = bve_queue.top_cost();
+	    int var = bve_queue.pop();
+	    int owner = batch.size() + 1;
+	    int nstart = neighbors.size();
+	    bool disjoint = true;
+	    for (int phase = 0; disjoint && phase <= 1; phase++) {
+		int lit = (2*phase - 1) * var;
+		for (int cid : (*literal_clauses)[lit]) {
+		    int len = clause_length(cid);
+		    for (int lid = 0; disjoint && lid < len; lid++) {
+			int cvar = IABS(get_literal(cid, lid));
+			if (neighbor_owner[cvar] == 0) {
+			    neighbor_owner[cvar] = owner;
+			    neighbors.push_back(cvar);
+			} else
+			    disjoint = neighbor_owner[cvar] == owner;
+		    }
+		    if (!disjoint)
+			break;
 		}
 	    }
-
-#else	    
-	    std::vector<int> dequeue_variables;
-	    for (int dvar : degree_variables[d]) {
-		dequeue_variables.push_back(dvar);
-		int dpos = (*literal_clauses)[dvar].size();
-		int dneg = (*literal_clauses)[-dvar].size();
-		if (eliminated_variables.find(dvar) == eliminated_variables.end() 
-		    && (dpos == d ||dneg == d)) {
-		    var = dvar;
-		    lit = dpos <= dneg ? var : -var;
-		    degree = d;
-		    break;
-		}
+	    if (disjoint)
+		batch.push_back(var);
+	    else {
+		for (int i = nstart; i < neighbors.size(); i++)
+		    neighbor_owner[neighbors[i]] = 0;
+		neighbors.resize(nstart);
+		deferred_variables.push_back(var);
+		deferred_costs.push_back(cost);
 	    }
-	    // House cleaning.  Variables found or wrongly classified
-	    for (int dvar : dequeue_variables)
-		degree_variables[d].erase(dvar);
-#endif
 	}
-	if (var == 0)
+	for (int nbvar : neighbors)
+	    neighbor_owner[nbvar] = 0;
+	neighbors.clear();
+	for (int i = 0; i < deferred_variables.size(); i++)
+	    bve_queue.update(deferred_variables[i], deferred_costs[i]);
+	if (batch.size() == 0)
 	    break;
-	int dpos = (*literal_clauses)[var].size();
-	int dneg = (*literal_clauses)[-var].size();
-	int deprecated_clause_count =  dpos + dneg;
-	int max_delta_clause_count = dpos * dneg - deprecated_clause_count;
-	if (max_delta_clause_count > maxadded)
-	    // Skip.  Might generate too many clauses
-	    continue;
-	// Perform BVE on var
-	int new_clause_count = 0;
-	eliminated_variables.insert(var);
-	if (preprocess)
-	    set_variable_type(var, VAR_ELIM);
-	std::unordered_set<int>change_variables;
-	std::vector<int>deprecate_clauses;
-	for (int cid1 : (*literal_clauses)[lit]) {
-	    deprecate_clauses.push_back(cid1);
-	    int len1 = clause_length(cid1);
-	    for (int lid1 = 0; lid1 < len1; lid1++) {
-		int lit1 = get_literal(cid1, lid1);
-		if (skip_literal(lit1))
-		    continue;
-		if (lit1 == lit)
-		    continue;
-		int var1 = IABS(lit1);
-		if (is_data_variable(var1))
-		    continue;
-		change_variables.insert(var1);
-	    }
-	}
-	for (int cid2 : (*literal_clauses)[-lit]) {
-	    deprecate_clauses.push_back(cid2);
-	    int len2 = clause_length(cid2);
-	    for (int lid2 = 0; lid2 < len2; lid2++) {
-		int lit2 = get_literal(cid2, lid2);
-		if (skip_literal(lit2))
-		    continue;
-		if (lit2 == -lit)
-		    continue;
-		int var2 = IABS(lit2);
-		if (is_data_variable(var2))
-		    continue;
-		change_variables.insert(var2);
-	    }
+	if (nworkers == 1) {
+	    for (int i = 0; i < batch.size(); i++)
+		bve_plan_elimination(batch[i], maxdegree, plans[i], scratch);
+	} else {
+	    std::atomic<int> next_index(0);
+	    std::vector<std::thread> workers;
+	    for (int t = 0; t < nworkers; t++)
+		workers.push_back(std::thread([this, t, maxdegree, &batch, &plans, &thread_scratch, &next_index]() {
+			    int i;
+			    while ((i = next_index++) < batch.size())
+				bve_plan_elimination(batch[i], maxdegree, plans[i], thread_scratch[t]);
+			}));
+	    for (std::thread &worker : workers)
+		worker.join();
 	}
-	for (int cid1 : (*literal_clauses)[lit]) {
-	    for (int cid2 : (*literal_clauses)[-lit]) {
-		int ncid = resolve(var, cid1, cid2);
-		if (ncid > 0)
-		    new_clause_count++;
+	for (int i = 0; i < batch.size(); i++) {
+	    bve_plan &plan = plans[i];
+	    // Earlier eliminations in batch can subsume or strengthen clauses containing this variable
+	    if (!bve_plan_current(plan)) {
+		report(4, "BVE plan for variable %d out of date.  Replanning\n", plan.var);
+		bve_plan_elimination(plan.var, maxdegree, plan, scratch);
 	    }
-	}
-	deactivate_clauses(deprecate_clauses);
-	for (int ovar : change_variables) {
-	    int odegree = IMIN((*literal_clauses)[ovar].size(), (*literal_clauses)[-ovar].size());
-	    if (odegree <= maxdegree) {
-#if STACK_BVE
-		degree_variables[odegree].push_back(ovar);
-#else	      
-		degree_variables[odegree].insert(ovar);
-#endif
-		report(5, "Projection variable %d.  Degree = %d\n", ovar, odegree);
+	    if (plan.accept) {
+		bve_eliminate(plan, preprocess, maxdegree, eliminated_variables);
+		// Could have been requeued by earlier elimination in batch
+		bve_queue.remove(plan.var);
 	    }
 	}
-	if (degree == 0 && bcp_unit_literals.find(-lit) == bcp_unit_literals.end())
-	    // Pure literal
-	    assign_literal(-lit, true);
-	report(3, "BVE on variable %d deprecated %d clauses and added %d new ones\n", var, deprecated_clause_count, new_clause_count);
-	if (preprocess) {
-	    incr_count_by(COUNT_BVE_ELIM_CLAUSE, deprecated_clause_count);
-	    incr_count_by(COUNT_BVE_NEW_CLAUSE, new_clause_count);
-	}
+	collect_garbage(false);
     }
+    if (preprocess)
+	incr_count_by(COUNT_BVE_HEAP_OP, bve_queue.operations() - start_operations);
+    bve_queue.clear();
     return (int) eliminated_variables.size();
 }
 #endif // !RANDOM_BVE
@@ -1273,9 +2481,16 @@ static bool increment_indices(std::vector<int> &lengths, std::vector<int> &indic
 }
 
 // Generate set of blocked clauses covering this literal & clauses
-void Cnf::blocked_clause_expand(int lit, std::vector<int> &clause_list) {
+// Together, these define -lit as a disjunction of terms, one per clause, with each term the conjunction of
+// the negated other literals.  Expanding this into CNF requires the product of the clause lengths.
+// When that exceeds the limits, define each term with an auxiliary Tseitin variable instead
+bool Cnf::blocked_clause_expand(int lit, std::vector<int> &clause_list) {
     std::vector<int> clause_lengths;
     std::vector<int> clause_indices;
+    // Clauses generated by expansion, stopping once limit exceeded
+    long expand_count = 1;
+    // Clauses generated with auxiliary variables
+    long aux_count = 1;
     for (int cid : clause_list) {
 	// Stick all uninteresting literals at the end
 	int len = clause_length(cid);
@@ -1289,41 +2504,91 @@ void Cnf::blocked_clause_expand(int lit, std::vector<int> &clause_list) {
 	}
 	clause_lengths.push_back(len);
 	clause_indices.push_back(0);
+	if (expand_count <= promote_variable_limit)
+	    expand_count *= len;
+	if (len > 1)
+	    aux_count += len + 1;
     }
-    int running = true;
+    int remaining = promote_total_limit - promote_clause_count;
     int first_cid = 0;
     int last_cid = 0;
-    while (running) {
-	int ncid = new_clause();
-	if (first_cid == 0)
-	    first_cid = ncid;
-	last_cid = ncid;
-	add_literal(-lit);
+    if (expand_count <= promote_variable_limit && expand_count <= remaining) {
+	int running = true;
+	while (running) {
+	    int ncid = new_clause();
+	    if (first_cid == 0)
+		first_cid = ncid;
+	    last_cid = ncid;
+	    add_literal(-lit);
+	    for (int i = 0; i < clause_list.size(); i++) {
+		int cid = clause_list[i];
+		int idx = clause_indices[i];
+		int clit = get_literal(cid, idx);
+		add_literal(-clit);
+	    }
+	    running = increment_indices(clause_lengths, clause_indices);
+	}
+    } else if (aux_count <= remaining) {
+	// Literal for each term
+	std::vector<int> term_lits;
 	for (int i = 0; i < clause_list.size(); i++) {
 	    int cid = clause_list[i];
-	    int idx = clause_indices[i];
-	    int clit = get_literal(cid, idx);
-	    add_literal(-clit);
+	    int len = clause_lengths[i];
+	    if (len == 1) {
+		term_lits.push_back(-get_literal(cid, 0));
+		continue;
+	    }
+	    int avar = new_variable();
+	    term_lits.push_back(avar);
+	    int ncid = new_clause();
+	    if (first_cid == 0)
+		first_cid = ncid;
+	    add_literal(avar);
+	    for (int lid = 0; lid < len; lid++)
+		add_literal(get_literal(cid, lid));
+	    for (int lid = 0; lid < len; lid++) {
+		new_clause();
+		add_literal(-avar);
+		add_literal(-get_literal(cid, lid));
+	    }
+	    set_variable_type(avar, VAR_TSEITIN_PROMOTE);
+	    tseitin_variables->insert(avar);
+	    incr_count(COUNT_PROMOTE_AUX_VAR);
 	}
-	incr_count(COUNT_PROMOTE_CLAUSE);
-	running = increment_indices(clause_lengths, clause_indices);
+	last_cid = new_clause();
+	if (first_cid == 0)
+	    first_cid = last_cid;
+	add_literal(-lit);
+	for (int tlit : term_lits)
+	    add_literal(tlit);
+	report(4, "Defined %d terms with auxiliary variables to promote variable %d\n", (int) term_lits.size(), IABS(lit));
+    } else {
+	report(3, "Promoting variable %d would exceed limit on promotion clauses\n", IABS(lit));
+	return false;
     }
+    int count = last_cid - first_cid + 1;
+    promote_clause_count += count;
+    incr_count_by(COUNT_PROMOTE_CLAUSE, count);
     report(4, "Added blocked clauses #%d .. %d to promote variable %d\n", first_cid, last_cid, IABS(lit));
+    return true;
 }
 
 
-// Detect whether variable is already Tseitin variable.  When promote is true, also attempt convert variable to Tseitin variable
-// Fill list of fanout nodes in event of success, so that these can then be tested
-bool Cnf::tseitin_variable_test(int var, bool promote, std::unordered_set<int> &fanout_vars) {
+// Detect whether variable is already Tseitin variable
+// Collect fanout variables, so that these can be tested in the event of success
+bool Cnf::tseitin_detect(tseitin_test &tt, resolve_scratch &rs, tseitin_oracle &toracle) {
+    int var = tt.var;
+    tt.dt_var_clause_list.clear();
+    tt.dt_lit_clause_list[0].clear();
+    tt.dt_lit_clause_list[1].clear();
+    tt.fanout_vars.clear();
+    tt.gate_detect = tt.sat_detect = tt.sat_called = false;
+    // Mark fanout variables to avoid duplicates
+    if (++rs.resolve_stamp == INT_MAX) {
+	std::fill(rs.variable_stamp.begin(), rs.variable_stamp.end(), 0);
+	rs.resolve_stamp = 1;
+    }
     // Construct sets of clauses that contain only data & known Tseitin variables
-    // For the variable
-    std::set<int> *dt_var_clause_set = new std::set<int>;
-    // For each phase
-    std::vector<int> dt_lit_clause_list[2];
-    // The other data and Tseitin literals that occur in these clauses
-    std::unordered_set<int> dt_otherlit_set[2];
-    // Clear the fanouts
-    fanout_vars.clear();
     for (int phase = 0; phase <= 1; phase ++) {
 	int lit = (2*phase - 1) * var;
 	for (int cid : (*literal_clauses)[lit]) {
@@ -1331,7 +2596,6 @@ bool Cnf::tseitin_variable_test(int var, bool promote, std::unordered_set<int> &
 		continue;
 	    int len = clause_length(cid);
 	    bool include = true;
-	    std::vector<int> other_lits;
 	    for (int lid = 0; lid < len; lid++) {
 		int clit = get_literal(cid, lid);
 		if (skip_literal(clit))
@@ -1339,81 +2603,188 @@ bool Cnf::tseitin_variable_test(int var, bool promote, std::unordered_set<int> &
 		int cvar = IABS(clit);
 		if (cvar == var)
 		    continue;
-		if (data_variables->find(cvar) != data_variables->end() 
-		    || tseitin_variables->find(cvar) != tseitin_variables->end()) 
-
-		    other_lits.push_back(clit);
-		else {
+		if (data_variables->find(cvar) == data_variables->end() 
+		    && tseitin_variables->find(cvar) == tseitin_variables->end()) {
 		    include = false;
-		    fanout_vars.insert(cvar);
-		    continue;
+		    if (rs.variable_stamp[cvar] != rs.resolve_stamp) {
+			rs.variable_stamp[cvar] = rs.resolve_stamp;
+			tt.fanout_vars.push_back(cvar);
+		    }
 		}
 	    }
 	    if (include) {
-		dt_var_clause_set->insert(cid);
-		dt_lit_clause_list[phase].push_back(cid);
-		for (int clit : other_lits)
-		    dt_otherlit_set[phase].insert(clit);
+		tt.dt_var_clause_list.push_back(cid);
+		tt.dt_lit_clause_list[phase].push_back(cid);
+	    }
+	}
+    }
+    // Gate definition over data and Tseitin variables makes SAT test unnecessary
+    if (find_gate(var, tt.gate_clauses, rs) && tseitin_gate_defined(var, tt.gate_clauses)) {
+	tt.gate_detect = true;
+	return true;
+    }
+    if (tt.dt_var_clause_list.size() >= 1)
+	tt.sat_detect = !tseitin_satisfiable(tt, toracle);
+    return tt.sat_detect;
+}
+
+bool Cnf::tseitin_gate_defined(int var, std::vector<int> &gate_clauses) {
+    for (int cid : gate_clauses) {
+	int len = clause_length(cid);
+	for (int lid = 0; lid < len; lid++) {
+	    int clit = get_literal(cid, lid);
+	    int cvar = IABS(clit);
+	    if (cvar == var || skip_literal(clit))
+		continue;
+	    if (data_variables->find(cvar) == data_variables->end()
+		&& tseitin_variables->find(cvar) == tseitin_variables->end())
+		return false;
+	}
+    }
+    return true;
+}
+
+// Variable is Tseitin when its clauses become unsatisfiable with its literals removed
+bool Cnf::tseitin_satisfiable(tseitin_test &tt, tseitin_oracle &toracle) {
+    double start = tod();
+    tt.sat_called = true;
+    tt.sat_clauses = tt.dt_var_clause_list.size();
+    // Try bit-parallel solver first
+    if (tt.sat_clauses <= MICROSAT_MAX_CLAUSE) {
+	Microsat msolver;
+	std::vector<int> lits;
+	bool small = true;
+	for (int cid : tt.dt_var_clause_list) {
+	    lits.clear();
+	    int len = clause_length(cid);
+	    for (int lid = 0; lid < len; lid++) {
+		int lit = get_literal(cid, lid);
+		if (IABS(lit) != tt.var && !skip_literal(lit))
+		    lits.push_back(lit);
 	    }
+	    if (!msolver.add_clause(lits.data(), lits.size())) {
+		small = false;
+		break;
+	    }
+	}
+	microsat_result_t mresult = small ? msolver.solve(MICROSAT_DECISION_LIMIT) : MICROSAT_UNKNOWN;
+	if (mresult != MICROSAT_UNKNOWN) {
+	    tt.sat_micro = true;
+	    tt.sat_seconds = tod() - start;
+	    return mresult == MICROSAT_SAT;
 	}
     }
-    bool sat = true;
-    if (dt_var_clause_set->size() >= 1) {
-	new_context();
-	push_active(dt_var_clause_set);
-	uquantify_variable(var);
-	sat = is_satisfiable();
+    tt.sat_micro = false;
+    Glucose::Solver &solver = *toracle.solver;
+    Glucose::Lit act = Glucose::mkLit(solver.newVar(true, false), false);
+    Glucose::vec<Glucose::Lit> gclause;
+    for (int cid : tt.dt_var_clause_list) {
+	gclause.clear();
+	gclause.push(~act);
+	int len = clause_length(cid);
+	for (int lid = 0; lid < len; lid++) {
+	    int lit = get_literal(cid, lid);
+	    int var = IABS(lit);
+	    if (var == tt.var || skip_literal(lit))
+		continue;
+	    if (toracle.solver_var[var] < 0)
+		toracle.solver_var[var] = solver.newVar();
+	    gclause.push(Glucose::mkLit(toracle.solver_var[var], lit < 0));
+	}
+	solver.addClause(gclause);
+    }
+    Glucose::vec<Glucose::Lit> assumptions;
+    assumptions.push(act);
+    bool result = solver.solve(assumptions);
+    // Disable clauses of this test.  Solver will remove them
+    solver.addClause(~act);
+    tt.sat_seconds = tod() - start;
+    return result;
+}
+
+void Cnf::tseitin_record(tseitin_test &tt) {
+    if (tt.sat_called) {
+	incr_timer(TIME_SAT, tt.sat_seconds);
+	incr_count(COUNT_SAT_CALL);
+	if (tt.sat_micro) {
+	    incr_count(COUNT_MICROSAT_CALL);
+	    incr_histo(HISTO_MICROSAT_CLAUSES, tt.sat_clauses);
+	} else
+	    incr_histo(HISTO_SAT_CLAUSES, tt.sat_clauses);
 	if (verblevel >= 5) {
-	    report(5, "Tseitin test gives %s for variable %d on clauses:", sat ? "failure" : "success", var);
-	    for (int cid : *dt_var_clause_set)
+	    report(5, "Tseitin test gives %s for variable %d on clauses:", tt.sat_detect ? "success" : "failure", tt.var);
+	    for (int cid : tt.dt_var_clause_list)
 		printf(" %d", cid);
 	    printf("\n");
 	}
-	pop_context();
     }
-    if (!sat)
-	return true;
-    if (!promote) {
-	fanout_vars.clear();
-	return false;
+    if (tt.gate_detect) {
+	report(4, "Gate definition shows variable %d is Tseitin\n", tt.var);
+	incr_count(COUNT_TSEITIN_GATE_DETECT);
     }
-    // See if can promote variable to Tseitin variable
+    if (tt.sat_detect)
+	incr_count(COUNT_TSEITIN_SAT_DETECT);
+}
+
+bool Cnf::tseitin_promote(tseitin_test &tt) {
+    int var = tt.var;
     for (int phase = 0; phase <=  1; phase++) {
 	int lit = (2*phase - 1) * var;
 	// Make sure no other clauses contain this literal
-	if (dt_lit_clause_list[phase].size() < (*literal_clauses)[lit].size())
+	if (tt.dt_lit_clause_list[phase].size() < (*literal_clauses)[lit].size())
 	    continue;
+	// The other data and Tseitin literals that occur in these clauses
+	std::unordered_set<int> dt_otherlit_set;
+	for (int cid : tt.dt_lit_clause_list[phase]) {
+	    int len = clause_length(cid);
+	    for (int lid = 0; lid < len; lid++) {
+		int clit = get_literal(cid, lid);
+		if (IABS(clit) != var && !skip_literal(clit))
+		    dt_otherlit_set.insert(clit);
+	    }
+	}
 	// Make sure all other literals in these clauses are pure
 	bool pure = true;
-	for (int olit : dt_otherlit_set[phase]) {
+	for (int olit : dt_otherlit_set) {
 	    if (olit < 0)
 		// Only look to one side of negagtion
 		continue;
-	    if (dt_otherlit_set[phase].find(-olit) != dt_otherlit_set[phase].end()) {
+	    if (dt_otherlit_set.find(-olit) != dt_otherlit_set.end()) {
 		pure = false;
 		break;
 	    }
 	}
 	// Go for it!
-	if (pure) {
-	    blocked_clause_expand(lit, dt_lit_clause_list[phase]);
+	if (pure && blocked_clause_expand(lit, tt.dt_lit_clause_list[phase])) {
 	    set_variable_type(var, VAR_TSEITIN_PROMOTE);
-	    report(3, "Promoted variable %d.  Fanout size = %d\n", var, (int) fanout_vars.size());
+	    report(3, "Promoted variable %d.  Fanout size = %d\n", var, (int) tt.fanout_vars.size());
 	    return true;
 	}
     }
-    fanout_vars.clear();
     return false;
 }
 
-void Cnf::classify_variables(bool promote) {
+// Detect whether variable is already Tseitin variable.  When promote is true, also attempt convert variable to Tseitin variable
+bool Cnf::tseitin_variable_test(tseitin_test &tt, bool promote) {
+    bool tseitin = tseitin_detect(tt, scratch, oracle);
+    tseitin_record(tt);
+    if (!tseitin && promote)
+	tseitin = tseitin_promote(tt);
+    return tseitin;
+}
+
+void Cnf::set_promote_limits(int variable_limit, int total_limit) {
+    promote_variable_limit = variable_limit;
+    promote_total_limit = total_limit;
+}
+
+void Cnf::classify_variables(bool promote, int nthreads) {
     double start = tod();
     tseitin_variables->clear();
+    oracle.initialize(nvar);
     // Set and queue of (potentially Tseitin) projection variables
     // Original list by definition occurrence, but then add fanouts of newly discovered/created variables
     unique_queue<int> pvar_queue;
-    // Fanouts of identified or promoted Tseitin variables
-    std::unordered_set<int> fanout_vars;
     // Variables that didn't get detected/promoted
     std::unordered_set<int> non_tseitin_vars;
 
@@ -1433,20 +2804,109 @@ void Cnf::classify_variables(bool promote) {
 		non_tseitin_vars.insert(var);
 	}
     }
-    while (!pvar_queue.empty()) {
-	int var = pvar_queue.get_and_pop();
-	if (tseitin_variable_test(var, promote, fanout_vars)) {
-	    if (get_variable_type(var) != VAR_TSEITIN_PROMOTE)
-		set_variable_type(var, VAR_TSEITIN_DETECT);
-	    tseitin_variables->insert(var);
-	    non_tseitin_vars.erase(var);
+    if (nthreads <= 1) {
+	tseitin_test tt;
+	while (!pvar_queue.empty()) {
+	    tt.var = pvar_queue.get_and_pop();
+	    if (tseitin_variable_test(tt, promote)) {
+		if (get_variable_type(tt.var) != VAR_TSEITIN_PROMOTE)
+		    set_variable_type(tt.var, VAR_TSEITIN_DETECT);
+		tseitin_variables->insert(tt.var);
+		non_tseitin_vars.erase(tt.var);
+		for (int fvar : tt.fanout_vars) {
+		    if (pvar_queue.push(fvar)) 
+			report(3, "Added fanout variable %d for Tseitin variable %d\n", fvar, tt.var);
+		}
+	    }
+	    incr_count(COUNT_TSEITIN_TEST);
+	    collect_garbage(false);
 	}
-	for (int fvar : fanout_vars) {
-	    if (pvar_queue.push(fvar)) 
-		report(3, "Added fanout variable %d for Tseitin variable %d\n", fvar, var);
+    } else {
+	// Take batches of variables from the front of the queue and detect Tseitin variables concurrently,
+	// relative to the Tseitin variables known at the start of the batch.
+	// Then apply the results in queue order.  A result is out of date when an earlier variable in the batch
+	// has become Tseitin and is one of its fanouts.  Detection remains valid, since adding Tseitin variables
+	// only adds clauses to the test, but failed tests are repeated.  Classification is then the same as sequential
+	std::vector<resolve_scratch> thread_scratch(nthreads);
+	std::vector<tseitin_oracle> thread_oracle(nthreads);
+	for (int t = 0; t < nthreads; t++) {
+	    thread_scratch[t].initialize(nvar);
+	    thread_oracle[t].initialize(nvar);
 	}
-	incr_count(COUNT_TSEITIN_TEST);
+	std::vector<tseitin_test> tests(TSEITIN_BATCH_SIZE);
+	std::vector<int> batch;
+	// For each variable, 1 + position in current batch until result applied, or 0.
+	// Variables still awaiting results are considered to be in the queue
+	std::vector<int> batch_position(nvar+1, 0);
+	while (!pvar_queue.empty()) {
+	    // Promotion can add variables
+	    for (int t = 0; t < nthreads; t++) {
+		thread_scratch[t].resize(nvar);
+		thread_oracle[t].resize(nvar);
+	    }
+	    batch_position.resize(nvar+1, 0);
+	    batch.clear();
+	    while (!pvar_queue.empty() && batch.size() < TSEITIN_BATCH_SIZE) {
+		int var = pvar_queue.get_and_pop();
+		batch.push_back(var);
+		batch_position[var] = batch.size();
+	    }
+	    std::atomic<int> next_index(0);
+	    std::vector<std::thread> workers;
+	    for (int t = 0; t < nthreads; t++)
+		workers.push_back(std::thread([this, t, &batch, &tests, &thread_scratch, &thread_oracle, &next_index]() {
+			    int i;
+			    while ((i = next_index++) < batch.size()) {
+				tests[i].var = batch[i];
+				tseitin_detect(tests[i], thread_scratch[t], thread_oracle[t]);
+			    }
+			}));
+	    for (std::thread &worker : workers)
+		worker.join();
+	    for (int i = 0; i < batch.size(); i++) {
+		tseitin_test &tt = tests[i];
+		batch_position[tt.var] = 0;
+		bool current = true;
+		int j = 0;
+		for (int fvar : tt.fanout_vars) {
+		    if (tseitin_variables->find(fvar) == tseitin_variables->end())
+			tt.fanout_vars[j++] = fvar;
+		    else
+			current = false;
+		}
+		tt.fanout_vars.resize(j);
+		// New Tseitin variables can complete gate definition
+		if (!current && tt.sat_detect && tt.gate_clauses.size() > 0 && tseitin_gate_defined(tt.var, tt.gate_clauses)) {
+		    tt.sat_detect = false;
+		    tt.gate_detect = true;
+		}
+		tseitin_record(tt);
+		bool tseitin = tt.gate_detect || tt.sat_detect;
+		if (!tseitin) {
+		    if (!current) {
+			report(4, "Tseitin test for variable %d out of date.  Retesting\n", tt.var);
+			tseitin = tseitin_variable_test(tt, promote);
+		    } else if (promote)
+			tseitin = tseitin_promote(tt);
+		}
+		if (tseitin) {
+		    if (get_variable_type(tt.var) != VAR_TSEITIN_PROMOTE)
+			set_variable_type(tt.var, VAR_TSEITIN_DETECT);
+		    tseitin_variables->insert(tt.var);
+		    non_tseitin_vars.erase(tt.var);
+		    for (int fvar : tt.fanout_vars) {
+			if (batch_position[fvar] == 0 && pvar_queue.push(fvar)) 
+			    report(3, "Added fanout variable %d for Tseitin variable %d\n", fvar, tt.var);
+		    }
+		}
+		incr_count(COUNT_TSEITIN_TEST);
+	    }
+	    collect_garbage(false);
+	}
+	for (tseitin_oracle &toracle : thread_oracle)
+	    toracle.deallocate();
     }
+    oracle.deallocate();
     report(3, "c Failed to detect/promote %d variables\n", (int) non_tseitin_vars.size());
     if (verblevel >= 5) {
 	printf("c Non-Tseitin vars:");
@@ -1462,14 +2922,107 @@ Compiler::Compiler(Pog *pg, bool d4v2) {
    pog = pg;
    bkc_limit = 0;
    use_d4v2 = d4v2;
+   pog_solver = NULL;
+   pog_true_var = -1;
+   pog_solver_clauses = 0;
+   pog_solver_full_clauses = 0;
 }
 
 Compiler::~Compiler() {
+    delete pog_solver;
+}
+
+// Polarity bits for node encoding
+#define POL_POS 0x1
+#define POL_NEG 0x2
+// Polarity seen by argument with literal lit
+#define POL_ARG(pol, lit) ((lit) > 0 ? (pol) : ((((pol) & POL_POS) << 1) | (((pol) & POL_NEG) >> 1)))
+
+int Compiler::pog_solver_lit(int lit) {
+    int var = pog->get_var(lit);
+    if (var == TAUTOLOGY)
+	return Glucose::toInt(Glucose::mkLit(pog_true_var, lit < 0));
+    if (pog_solver_var[var] < 0)
+	pog_solver_var[var] = pog_solver->newVar();
+    return Glucose::toInt(Glucose::mkLit(pog_solver_var[var], lit < 0));
+}
+
+int Compiler::pog_encode(int edge) {
+    if (pog_solver == NULL) {
+	pog_solver = new Glucose::Solver();
+	pog_solver->verbosity = 0;
+	pog_true_var = pog_solver->newVar();
+	pog_solver->addClause(Glucose::mkLit(pog_true_var));
+	pog_solver_clauses++;
+	pog_solver_full_clauses++;
+    }
+    int nvar = pog->variable_count();
+    if (pog_solver_var.size() < nvar + pog->node_count() + 1) {
+	pog_solver_var.resize(nvar + pog->node_count() + 1, -1);
+	pog_solver_polarity.resize(nvar + pog->node_count() + 1, 0);
+    }
+    // Asserting the edge requires the node to imply its definition when the edge is positive,
+    // and the definition to imply the node when it is negative.  Encode only the directions needed
+    std::vector<std::pair<int,int>> stack;
+    stack.push_back({pog->get_var(edge), POL_ARG(POL_POS, edge)});
+    while (stack.size() > 0) {
+	int var = stack.back().first;
+	int pol = stack.back().second;
+	stack.pop_back();
+	if (!pog->is_node(var))
+	    continue;
+	int missing = pol & ~pog_solver_polarity[var];
+	if (missing == 0)
+	    continue;
+	if (pog_solver_polarity[var] == 0)
+	    pog_solver_full_clauses += pog->get_degree(var) + 1;
+	pog_solver_polarity[var] |= missing;
+	int degree = pog->get_degree(var);
+	bool is_sum = pog->is_sum(var);
+	Glucose::Lit nlit = Glucose::toLit(pog_solver_lit(is_sum ? -var : var));
+	// Long clause: sum node implies some argument, or all arguments imply product node
+	bool long_clause = (missing & (is_sum ? POL_POS : POL_NEG)) != 0;
+	// Binary clauses: argument implies sum node, or product node implies each argument
+	bool binary_clauses = (missing & (is_sum ? POL_NEG : POL_POS)) != 0;
+	Glucose::vec<Glucose::Lit> gclause;
+	gclause.push(nlit);
+	for (int idx = 0; idx < degree; idx++) {
+	    int clit = pog->get_argument(var, idx);
+	    Glucose::Lit slit = Glucose::toLit(pog_solver_lit(clit));
+	    gclause.push(is_sum ? slit : ~slit);
+	    if (binary_clauses) {
+		pog_solver->addClause(~nlit, is_sum ? ~slit : slit);
+		pog_solver_clauses++;
+	    }
+	    stack.push_back({pog->get_var(clit), POL_ARG(missing, clit)});
+	}
+	if (long_clause) {
+	    pog_solver->addClause(gclause);
+	    pog_solver_clauses++;
+	}
+    }
+    return pog_solver_lit(edge);
+}
+
+bool Compiler::satisfiable(std::vector<int> &root_literals) {
+    double start = tod();
+    Glucose::vec<Glucose::Lit> assumptions;
+    for (int root : root_literals)
+	assumptions.push(Glucose::toLit(pog_encode(root)));
+    bool result = pog_solver->solve(assumptions);
+    incr_timer(TIME_SAT, tod() - start);
+    incr_count(COUNT_SAT_CALL);
+    incr_histo(HISTO_SAT_CLAUSES, pog_solver_clauses);
+    incr_histo(HISTO_SAT_POLARITY_SAVED, pog_solver_full_clauses - pog_solver_clauses);
+    report(5, "Calling incremental SAT solver with %d root literals and %d encoded clauses (%d with full Tseitin encoding) yields %s\n",
+	   (int) root_literals.size(), pog_solver_clauses, pog_solver_full_clauses, result ? "SAT" : "UNSAT");
+    return result;
 }
 
 // Encode portions of POG.  
 // Mark as data variables those arguments that aren't nodes
-Cnf *Compiler::clausify(std::vector<int> &root_literals) {
+// With polarity, emit only the implication directions required by the occurrences of each node
+Cnf *Compiler::clausify(std::vector<int> &root_literals, bool polarity) {
     std::map<int,int> node_remap;
     pog->get_subgraph(root_literals, node_remap);
     if (verblevel >= 5) {
@@ -1478,34 +3031,58 @@ Cnf *Compiler::clausify(std::vector<int> &root_literals) {
 	    printf(" %d-->%d", kv.first, kv.second);
 	printf("\n");
     }
+    // Nodes are numbered after their arguments, and so visiting them in descending order
+    // propagates polarities from the roots downward
+    std::unordered_map<int,int> node_polarity;
+    for (int orid : root_literals)
+	node_polarity[pog->get_var(orid)] |= POL_ARG(polarity ? POL_POS : POL_POS|POL_NEG, orid);
+    for (auto iter = node_remap.rbegin(); iter != node_remap.rend(); iter++) {
+	int onid = iter->first;
+	int pol = polarity ? node_polarity[onid] : POL_POS|POL_NEG;
+	int degree = pog->get_degree(onid);
+	for (int idx = 0; idx < degree; idx++) {
+	    int oclit = pog->get_argument(onid, idx);
+	    if (pog->is_node(oclit))
+		node_polarity[pog->get_var(oclit)] |= POL_ARG(pol, oclit);
+	}
+    }
 
     Cnf *cnf = new Cnf(pog->variable_count() + node_remap.size());
     cnf->data_variables = new std::unordered_set<int>;
+    int full_count = 0;
     for (auto kv : node_remap) {
 	int onid = kv.first;
 	int nnid = kv.second;
 	int degree = pog->get_degree(onid);
 	bool is_sum = pog->is_sum(onid);
-	cnf->new_clause();
-	cnf->add_literal(is_sum ? -nnid : nnid);
+	int pol = polarity ? node_polarity[onid] : POL_POS|POL_NEG;
+	full_count += degree + 1;
 	for (int idx = 0; idx < degree; idx++) {
-	    int oclit = pog->get_argument(onid, idx);
-	    int ocvar = pog->get_var(oclit);
-	    bool is_node = pog->is_node(ocvar);
-	    int ncvar = is_node ? node_remap[ocvar] : ocvar;
-	    int nclit = oclit < 0 ? -ncvar : ncvar;
-	    cnf->add_literal(is_sum ? nclit : -nclit);
-	    if (!is_node)
+	    int ocvar = pog->get_var(pog->get_argument(onid, idx));
+	    if (!pog->is_node(ocvar))
 		cnf->data_variables->insert(ocvar);
 	}
-	for (int idx = 0; idx < degree; idx++) {
+	if (pol & (is_sum ? POL_POS : POL_NEG)) {
 	    cnf->new_clause();
-	    cnf->add_literal(is_sum ? nnid : -nnid);
-	    int oclit = pog->get_argument(onid, idx);
-	    int ocvar = pog->get_var(oclit);
-	    int ncvar = pog->is_node(ocvar) ? node_remap[ocvar] : ocvar;
-	    int nclit = oclit < 0 ? -ncvar : ncvar;
-	    cnf->add_literal(is_sum ? -nclit : nclit);
+	    cnf->add_literal(is_sum ? -nnid : nnid);
+	    for (int idx = 0; idx < degree; idx++) {
+		int oclit = pog->get_argument(onid, idx);
+		int ocvar = pog->get_var(oclit);
+		int ncvar = pog->is_node(ocvar) ? node_remap[ocvar] : ocvar;
+		int nclit = oclit < 0 ? -ncvar : ncvar;
+		cnf->add_literal(is_sum ? nclit : -nclit);
+	    }
+	}
+	if (pol & (is_sum ? POL_NEG : POL_POS)) {
+	    for (int idx = 0; idx < degree; idx++) {
+		cnf->new_clause();
+		cnf->add_literal(is_sum ? nnid : -nnid);
+		int oclit = pog->get_argument(onid, idx);
+		int ocvar = pog->get_var(oclit);
+		int ncvar = pog->is_node(ocvar) ? node_remap[ocvar] : ocvar;
+		int nclit = oclit < 0 ? -ncvar : ncvar;
+		cnf->add_literal(is_sum ? -nclit : nclit);
+	    }
 	}
     }
     for (int orid : root_literals) {
@@ -1519,9 +3096,35 @@ Cnf *Compiler::clausify(std::vector<int> &root_literals) {
 	    cnf->data_variables->insert(orvar);
     }
     cnf->finish();
+    if (polarity)
+	report(4, "Polarity-aware clausify of %d nodes.  %d node clauses (%d with full Tseitin encoding)\n",
+	       (int) node_remap.size(), cnf->current_clause_count() - (int) root_literals.size(), full_count);
     return cnf;
 }
 
+// Clausify cone of root literals and compile it.
+// Polarity-aware encoding leaves node variables free in one direction, and so they
+// must be projected by D4 v2, rather than split on by the builtin KC
+int Compiler::compile_cone(std::vector<int> &root_literals, bool trim, bool polarity) {
+    Cnf *cnf = NULL;
+    bool project = polarity && trim && use_d4v2;
+    if (project) {
+	cnf = clausify(root_literals, true);
+	if (cnf->nonunit_clause_count() <= bkc_limit) {
+	    cnf->deallocate();
+	    delete cnf;
+	    cnf = NULL;
+	    project = false;
+	}
+    }
+    if (cnf == NULL)
+	cnf = clausify(root_literals, false);
+    int root = compile(cnf, trim, project);
+    cnf->deallocate();
+    delete cnf;
+    return root;
+}
+
 // Compile, integrate into POG and return pointer to root literal
 int Compiler::compile(Cnf *cnf, bool trim, bool defer) {
     int root = 0;
@@ -1638,7 +3241,7 @@ int Compiler::builtin_kc(Cnf *cnf, bool trim, bool defer, bool top_level) {
 	cnf->new_context();
 	cnf->assign_literal(slit, false);
 	int bcount = cnf->bcp(false);
-	int pcount = cnf->bve(false, 0);
+	int pcount = cnf->bve(false, 0, 1);
 	report(5, "Builtin KC on %d clauses (splitting literal %d).  BCP found %d units.  BVE found %d pure\n", ccount, slit, bcount, pcount);
 	if (verblevel >= 5) {
 	    report(5, "CNF post BCP/BVE:\n");
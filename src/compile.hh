@@ -28,9 +28,13 @@
 
 #include <set>
 #include <unordered_set>
+#include <cstdint>
 
 #include "pog.hh"
 
+class Reader;
+namespace Glucose { class Solver; }
+
 
 // Get header info from CNF file
 bool read_cnf_header(const char* cnf_name, int &nvar, int &nclause);
@@ -40,11 +44,8 @@ typedef enum {
     ACTION_START_CONTEXT,      // Start of new context
     ACTION_CONFLICT,           // Found conflict
     ACTION_DEACTIVATE_CLAUSE,  // Deactivated clause
-    ACTION_BCP,                // Derived unit literal by BCP
-    ACTION_ASSERT,             // Asserted unit literal externally
     ACTION_ASSERT_FROM_BCP,    // Convert BCP unit literal into asserted literal
-    ACTION_UQUANTIFY,          // Universally quantify variable
-    ACTION_ACTIVE_CLAUSES,     // New set of active clauses
+    ACTION_UNWATCHED_CLAUSE,   // Removed clause from unwatched list without assigning watches
     ACTION_NUM                 // Count
 } action_t;
 
@@ -53,10 +54,199 @@ struct action_record {
     int ele;  // Clause ID or literal
 };
 
-// Have ability to store active clause set + map on stack
-struct active_record {
-    std::set<int> *active_clauses;
-    std::unordered_map<int,std::unordered_set<int>> *literal_clauses;
+// Encode literal as nonnegative integer
+#define LCODE(lit) (2*IABS(lit) + ((lit) < 0))
+
+// Set of clause IDs.  Membership is recorded in a bitmap, giving constant-time insertion,
+// removal, and membership tests.  Members are also kept in a list.  Removed clauses are
+// only purged from the list, and newly inserted ones merged into order, when the set is next iterated.
+// Iteration is in ascending order of clause ID
+class clause_set {
+private:
+    // Members
+    std::vector<uint64_t> member_bits;
+    // Clauses in member list.  Superset of members
+    std::vector<uint64_t> listed_bits;
+    std::vector<int> members;
+    // Number of elements at start of member list that are in ascending order
+    int nsorted;
+    int count;
+
+    bool test_bit(std::vector<uint64_t> &bits, int cid) { 
+	return (cid >> 6) < bits.size() && (bits[cid >> 6] >> (cid & 63)) & 1;
+    }
+    // Remove nonmembers from list and put it in order
+    void compact();
+
+public:
+    clause_set() { nsorted = 0; count = 0; }
+
+    // Return true if clause was not already member
+    bool insert(int cid);
+    void erase(int cid);
+    void clear();
+    bool is_member(int cid) { return test_bit(member_bits, cid); }
+    int size() { return count; }
+
+    std::vector<int>::iterator begin() { compact(); return members.begin(); }
+    std::vector<int>::iterator end() { compact(); return members.end(); }
+};
+
+// For each literal, the list of clauses containing it.
+// Lists are indexed by the encoding 2*var + (lit < 0), so that lookups and
+// degree queries are array accesses.  Each clause occurs at most once in a list.
+// Removal swaps the clause with the last element of the list.  To make this O(1), the
+// position of each clause within the list is recorded for each entry in the
+// literal sequence.
+//
+// Memory: 4 bytes per list entry + 4 bytes per literal position + 24 bytes per list.
+// For 1M random 3-literal clauses over 300K variables, this comes to around 45MB,
+// compared to around 200MB for the hash map of hash sets it replaced.
+class occurrence_lists {
+private:
+    // Clause storage of CNF
+    std::vector<int> *clause_offset;
+    std::vector<int> *literal_sequence;
+    std::vector<std::vector<int>> lists;
+    // Indexed by position in literal sequence
+    std::vector<int> position;
+
+public:
+    occurrence_lists(std::vector<int> *clause_offset, std::vector<int> *literal_sequence);
+
+    void initialize(int nvar);
+    // Make room for variables added after initialization
+    void resize(int nvar) { lists.resize(2*(nvar+1)); }
+
+    // Add clause containing literal at position pos of literal sequence.
+    // Return false if clause already in list
+    bool add(int lit, int cid, int pos);
+    // Remove clause, if present.
+    void remove(int lit, int cid, int pos);
+    // Literals at two positions of literal sequence have been exchanged
+    void swap_positions(int pos1, int pos2);
+    // Support for garbage collection.  Literal has moved to new position in literal sequence
+    void move_position(int from, int to) { position[to] = position[from]; }
+    // Replace clause IDs according to map.  Lists must only contain clauses that remain
+    void renumber(std::vector<int> &cid_map);
+
+    std::vector<int> &operator[](int lit) { return lists[LCODE(lit)]; }
+};
+
+// Binary min-heap of variables, ordered by cost with ties broken by variable number.
+// Position of each variable in heap is recorded, so that its cost can be changed
+// and it can be removed in logarithmic time
+class variable_heap {
+private:
+    std::vector<int> heap;
+    // Indexed by variable.  Position in heap, or -1 when not present
+    std::vector<int> index;
+    std::vector<int> cost;
+    // Number of insertions, cost changes, and removals
+    long operation_count;
+
+    bool less(int var1, int var2) { 
+	return cost[var1] < cost[var2] || (cost[var1] == cost[var2] && var1 < var2);
+    }
+    void place(int pos, int var) { heap[pos] = var; index[var] = pos; }
+    void sift_up(int pos);
+    void sift_down(int pos);
+
+public:
+    void initialize(int nvar);
+    // Make room for variables added after initialization
+    void resize(int nvar) { index.resize(nvar+1, -1); cost.resize(nvar+1, 0); }
+    // Remove all variables
+    void clear();
+    bool empty() { return heap.size() == 0; }
+    bool contains(int var) { return index[var] >= 0; }
+    int top_cost() { return cost[heap[0]]; }
+    // Insert variable or change its cost
+    void update(int var, int c);
+    // Remove variable, if present
+    void remove(int var);
+    // Remove and return variable with lowest cost
+    int pop();
+    long operations() { return operation_count; }
+};
+
+// Working storage for generating resolvents and finding gates.
+// BVE threads each have their own
+struct resolve_scratch {
+    // Marks variables of resolvent being generated, signed by phase.  Indexed by var
+    std::vector<int> variable_stamp;
+    int resolve_stamp;
+    // Literals of clause being checked for subsumption.  Indexed by LCODE
+    std::vector<char> literal_mark;
+    // During gate detection, binary clause containing the literal and the negated gate output.  Indexed by LCODE
+    std::vector<int> gate_binary;
+    // Gate clauses found when computing costs
+    std::vector<int> gate_clauses;
+
+    void initialize(int nvar);
+    void resize(int nvar);
+};
+
+// Resolvents for eliminating variable by BVE
+struct bve_plan {
+    int var;
+    // Literal with lower degree
+    int lit;
+    // Clauses containing the variable when the plan was made
+    std::vector<int> occurrences;
+    // Clauses defining variable
+    std::vector<int> gate_clauses;
+    // Pairs of clauses to resolve
+    std::vector<int> pairs;
+    // Resolvents, stored consecutively
+    std::vector<int> resolvent_literals;
+    // Starting position of each resolvent, plus final position
+    std::vector<int> resolvent_start;
+    std::vector<int> rlits;
+    // Order in which to add resolvents
+    std::vector<int> resolvent_order;
+    // Should variable be eliminated
+    bool accept;
+};
+
+// Incremental solver for Tseitin tests.  The clauses of each test are guarded by a fresh activation literal.
+// Threads of parallel classification each have their own
+struct tseitin_oracle {
+    Glucose::Solver *solver;
+    // Solver variable for each variable, or -1 if not yet created.  Indexed by var
+    std::vector<int> solver_var;
+
+    tseitin_oracle() { solver = NULL; }
+    void initialize(int nvar);
+    void resize(int nvar) { solver_var.resize(nvar+1, -1); }
+    void deallocate();
+};
+
+// Outcome of testing whether variable is Tseitin
+struct tseitin_test {
+    int var;
+    // Clauses containing only the variable plus data & known Tseitin variables.  For the variable and for each phase
+    std::vector<int> dt_var_clause_list;
+    std::vector<int> dt_lit_clause_list[2];
+    // Other projection variables occurring in clauses with the variable, in order of first occurrence
+    std::vector<int> fanout_vars;
+    // Clauses defining variable as output of gate
+    std::vector<int> gate_clauses;
+    // How variable was shown to be Tseitin
+    bool gate_detect;
+    bool sat_detect;
+    // SAT call made by test.  Counted by the main thread
+    bool sat_called;
+    bool sat_micro;
+    int sat_clauses;
+    double sat_seconds;
+};
+
+// Assignment state of variable during KC
+struct variable_state {
+    signed char value;    // +1 or -1 when assigned, 0 otherwise
+    bool bcp;             // Assignment derived by BCP
+    int level;            // Context depth at which variable was assigned
 };
 
 // Variable types
@@ -70,12 +260,35 @@ typedef enum {
     VAR_NUM       
 } var_t;
 
+// Header for binary snapshot of preprocessed CNF
+#define SNAPSHOT_COUNTERS 10
+struct snapshot_header {
+    char magic[8];
+    int32_t version;
+    int32_t byte_order;
+    // Preprocessing settings used to generate snapshot
+    int32_t preprocess_level;
+    int32_t tseitin_mode;
+    int32_t nvar;
+    int32_t nclause;
+    int32_t nliteral;
+    int32_t nunit;
+    int32_t ndata;
+    int32_t ntseitin;
+    int32_t nweight;
+    // Preprocessing statistics
+    int32_t counters[SNAPSHOT_COUNTERS];
+};
+
+// Does buffer hold a snapshot?
+bool is_snapshot(const char *buf, size_t len);
+
 class Cnf {
 private:
     
     int nvar;
     // Type information about each variable.  Indexed by var-1.  Use for final information reporting
-    var_t *variable_type;
+    std::vector<var_t> variable_type;
 
     // For each clause, its starting index into the literal_sequence array
     // A final index beyond the last clause to make it easy to compute clause lengths
@@ -85,22 +298,52 @@ private:
 
     // Map from literal to set of clauses containing it.
     // Used for (BCP), BVE, and Tseitin detection/promotion
-    std::unordered_map<int,std::unordered_set<int>> *literal_clauses;
+    occurrence_lists *literal_clauses;
 
     // Support for KC
     bool has_conflict;
     // Record history of KC
     std::vector<action_record> action_stack;
-    // History of active clause set
-    std::vector<active_record> active_stack;
     // Set of clauses that are not satisfied and haven't reduced to units
-    std::set<int> *active_clauses;
-    // Units that were either derived by BCP or were asserted
-    std::unordered_set<int> unit_literals;
-    // Subset of units that are from BCP
-    std::unordered_set<int> bcp_unit_literals;
-    // Universally quantified variables
-    std::unordered_set<int> uquantified_variables;
+    clause_set *active_clauses;
+    // Assignment state of each variable.  Indexed by var
+    std::vector<variable_state> var_state;
+    // Variables that have been assigned (either derived by BCP or asserted), in order.  Popping a context truncates the trail back to the variables of the enclosing context
+    std::vector<int> trail;
+    // Number of open contexts
+    int context_level;
+    // Number of assignments derived by BCP
+    int bcp_unit_count;
+
+    // Watched-literal BCP
+    // Trail position from which BCP continues.  Saved by each context
+    int trail_head;
+    // Each clause with at least two literals watches two of them.  Stored at positions 2*cid and 2*cid+1.
+    // 0 when clause has never been watched
+    std::vector<int> watch_literals;
+    // For each encoded literal, clauses watching it.  Can contain stale entries, which get removed when the list is scanned
+    std::vector<std::vector<int>> watch_lists;
+    // Clauses that must be examined before their watches can be trusted: new clauses,
+    // and those that were unit, conflicting, or inactive when last examined
+    std::vector<int> unwatched_clauses;
+    // Number of literals in active clauses of the outermost context.  Used to trigger garbage collection
+    int active_literal_count;
+    // Candidate variables for BVE
+    variable_heap bve_queue;
+    // For each variable, batch variable whose clauses contain it.  All zero between BVE batches
+    std::vector<int> bve_neighbor_owner;
+    // For each clause, bit mask with one bit set per literal hash.  Indexed by clause ID
+    std::vector<uint64_t> clause_signature;
+    // Working storage for resolution and subsumption outside of parallel BVE
+    resolve_scratch scratch;
+    // Solver for Tseitin tests outside of parallel classification
+    tseitin_oracle oracle;
+    // Maximum number of clauses when promoting a variable by direct expansion, and in total for all promotions
+    int promote_variable_limit;
+    int promote_total_limit;
+    int promote_clause_count;
+    // Scratch list of clauses satisfied by a BCP assignment
+    std::vector<int> satisfied_clauses;
     // Debugging support
     int trace_variable;
 
@@ -109,6 +352,13 @@ public:
     Cnf(int icount);
 
     bool import_file(FILE *infile, bool process_comments);
+    // Faster version that parses memory-mapped file contents directly
+    bool import_reader(Reader &in, bool process_comments);
+
+    // Save/restore preprocessed formula as binary snapshot
+    bool write_snapshot(FILE *outfile, int preprocess_level, char tseitin_mode);
+    // Warn if snapshot was generated with preprocessing settings other than those given
+    bool import_snapshot(const char *buf, size_t len, int preprocess_level, char tseitin_mode);
 
     ~Cnf();
 
@@ -117,6 +367,8 @@ public:
     void deallocate();
 
     int variable_count() { return nvar; }
+    // Add variable that does not occur in the input.  Returns the variable
+    int new_variable();
     int nonunit_clause_count();
     int current_clause_count();
     int maximum_clause_id();
@@ -134,8 +386,6 @@ public:
     void add_literal(int lit);
     void finish();
 
-    bool is_satisfiable();
-
     // Public access to extra information
     std::unordered_set<int> *data_variables;
     // Variables that were detected to have Tseitin property during preprocessing
@@ -147,7 +397,6 @@ public:
     void new_context();
     void pop_context();
     void assign_literal(int lit, bool bcp);
-    void uquantify_variable(int var);
     int bcp(bool preprocess);
     
     // Check if clauses consist of disjoint literals
@@ -163,12 +412,16 @@ public:
 
     // Eliminate projection variables by bounded variable elimination
     // Replaces clauses containing them with resolvents
-    // Return number of variables eliminated
-    int bve(bool preprocess, int maxdegree);
+    // Return number of variables eliminated.
+    // With multiple threads, eliminate batches of variables, generating their resolvents concurrently
+    int bve(bool preprocess, int maxdegree, int nthreads);
     
     // Divide non-data variables into Tseitin & Projection variables
     // If promote, then perform Tseitin promotion
-    void classify_variables(bool promote);
+    // With multiple threads, test batches of variables concurrently.  Classification is the same as with one thread
+    void classify_variables(bool promote, int nthreads);
+    // Limits on clauses added by Tseitin promotion
+    void set_promote_limits(int variable_limit, int total_limit);
 
     // Get count of each variable type
     int get_variable_type_count(var_t type);
@@ -177,15 +430,41 @@ private:
     void set_variable_type(int var, var_t type);
     var_t get_variable_type(int var);
 
-    bool tseitin_variable_test(int var, bool promote, 
-			     std::unordered_set<int> &fanout_vars);
-    // Add blocked clauses
-    void blocked_clause_expand(int lit, std::vector<int> &clause_list);
+    // Detect whether variable is Tseitin, given the current Tseitin variables.
+    // Does not modify the clauses, and so threads can run it concurrently with their own scratch storage and oracles
+    bool tseitin_detect(tseitin_test &tt, resolve_scratch &rs, tseitin_oracle &toracle);
+    // Do the other variables in gate clauses consist of data & Tseitin variables
+    bool tseitin_gate_defined(int var, std::vector<int> &gate_clauses);
+    // Are the data/Tseitin clauses satisfiable with the variable removed
+    bool tseitin_satisfiable(tseitin_test &tt, tseitin_oracle &toracle);
+    // Update counters with outcome of detection
+    void tseitin_record(tseitin_test &tt);
+    // Attempt to convert variable to Tseitin variable, after detection has failed
+    bool tseitin_promote(tseitin_test &tt);
+    // Detection, followed by promotion when enabled.  Fanouts are meaningful only on success
+    bool tseitin_variable_test(tseitin_test &tt, bool promote);
+    // Add blocked clauses.  Return false if would exceed limit on promotion clauses
+    bool blocked_clause_expand(int lit, std::vector<int> &clause_list);
 
     bool skip_literal(int lit);
     bool skip_clause(int cid);
     void trigger_conflict();
-    int propagate_clause(int cid);
+
+    // Assignment state
+    bool literal_true(int lit) {
+	return var_state[IABS(lit)].value == (lit > 0 ? 1 : -1);
+    }
+    bool literal_false(int lit) {
+	return var_state[IABS(lit)].value == (lit > 0 ? -1 : 1);
+    }
+    void push_trail(int var);
+    // Get literals assigned by BCP
+    void get_bcp_units(std::vector<int> &units);
+    // Examine clause.  Set watches when it has at least two nonfalse literals
+    // Return TAUTOLOGY, CONFLICT, propagated unit, or zero
+    int watch_clause(int cid);
+    // Visit clauses watching newly false literal.  Return number of units found
+    int propagate_false(int lit, bool preprocess);
 
     void activate_clause(int cid);
     void deactivate_clause(int cid);
@@ -194,11 +473,48 @@ private:
     // Instead, store in vector and later due batch of them
     void deactivate_clauses(std::vector<int> &remove);
 
-    // Save set of active clauses; start new one; update literal_clauses
-    void push_active(std::set<int> *nactive_clauses);
-
     // Resolution
     int resolve(int var, int cid1, int cid2);
+    // Compute literals of resolvent.  Return false if tautology.
+    // When nlits is NULL, only check for tautology
+    bool resolvent(int var, int cid1, int cid2, std::vector<int> *nlits, resolve_scratch &rs);
+    // Number of nontautological resolvents from list of clause pairs
+    int count_resolvents(int var, std::vector<int> &pairs, resolve_scratch &rs);
+
+    // Gate-based elimination
+    // Get nonfalsified literals of ternary clause.  Return false if clause doesn't have exactly three
+    bool ternary_literals(int cid, int *lits);
+    // Find active ternary clause with these literals.  Return 0 if none
+    int find_ternary(int lit1, int lit2, int lit3);
+    // Find clauses defining variable as AND, OR, XOR, or ITE of other literals.
+    // Return false if none found
+    bool find_gate(int var, std::vector<int> &gate_clauses, resolve_scratch &rs);
+    // Determine whether variable is BVE candidate, and if so, its estimated clause growth.
+    // Fill list of gate clauses, if any
+    bool bve_candidate(int var, int maxdegree, int &cost, std::vector<int> &gate_clauses, resolve_scratch &rs);
+    // Decide whether to eliminate variable, and if so, generate its resolvents.
+    // Doesn't modify the clauses, and so can run concurrently for different variables
+    bool bve_plan_elimination(int var, int maxdegree, bve_plan &plan, resolve_scratch &rs);
+    // Check that clauses containing variable have not changed since plan was made
+    bool bve_plan_current(bve_plan &plan);
+    // Replace clauses containing variable with planned resolvents
+    void bve_eliminate(bve_plan &plan, bool preprocess, int maxdegree, std::unordered_set<int> &eliminated_variables);
+
+    // Subsumption during BVE
+    uint64_t literal_signature(int lit) { return (uint64_t) 1 << (LCODE(lit) & 63); }
+    void mark_literals(std::vector<int> &lits, bool value, resolve_scratch &rs);
+    // Return true if an active clause subsumes the literals.
+    // Otherwise, remove literals by self-subsuming resolution with active clauses
+    bool forward_subsume(std::vector<int> &lits, int &strengthen_count, resolve_scratch &rs);
+    // Deactivate clauses subsumed by new clause and replace those it strengthens.
+    // Ignore clauses containing variable being eliminated.  Return number of subsumed clauses
+    int backward_subsume(int ncid, int var, std::unordered_set<int> &change_variables, int &strengthen_count);
+    // Add other projection variables in clause to set
+    void note_change_variables(int cid, int var, std::unordered_set<int> &change_variables);
+
+    // Reclaim storage of inactive clauses, renumbering the remaining ones.
+    // Unless forced, only does so when enough storage would be reclaimed
+    void collect_garbage(bool force);
 
 };
 
@@ -210,6 +526,18 @@ private:
     // Limit on number of clauses for which do builtin KC
     int bkc_limit;
     bool use_d4v2;
+    // Incremental solver holding the Tseitin encoding of POG nodes.
+    // Nodes are encoded when first reached by a query and retained, along with learned clauses
+    Glucose::Solver *pog_solver;
+    // Solver variable for each POG variable and node, or -1 if not yet encoded.  Indexed by var
+    std::vector<int> pog_solver_var;
+    // Solver variable held true, for constant edges
+    int pog_true_var;
+    // Implication directions encoded for each node (bit 0: node implies definition, bit 1: converse)
+    std::vector<char> pog_solver_polarity;
+    int pog_solver_clauses;
+    // Clauses that would be required by full Tseitin encoding of the encoded nodes
+    int pog_solver_full_clauses;
 
 public:
     Compiler(Pog *pog, bool use_d4v2);
@@ -219,7 +547,13 @@ public:
 
     // Encode portions of POG.
     // Detect data variables
-    Cnf *clausify(std::vector<int> &root_literals);
+    // With polarity, generate only the clauses required for satisfiability (Plaisted-Greenbaum)
+    Cnf *clausify(std::vector<int> &root_literals, bool polarity = false);
+    // Clausify and compile.  Use polarity-aware encoding when trimming with D4 v2
+    int compile_cone(std::vector<int> &root_literals, bool trim, bool polarity);
+    // Determine whether conjunction of root literals is satisfiable,
+    // using incremental solver with root literals as assumptions
+    bool satisfiable(std::vector<int> &root_literals);
     // Compile, integrate into POG and return pointer to root literal
     int compile(const char *cnf_name, std::unordered_set<int> *data_variables, bool trim);
     // Compile CNF representation.
@@ -233,4 +567,10 @@ private:
     // Performs reductions in anticipation of projection
     // assume_tseitin indicates that all projection variables are Tseitin variables
     int builtin_kc(Cnf *cnf, bool assume_tseitin, bool defer, bool toplevel);
+    // Add clauses for nodes in cone of edge that are not yet encoded.
+    // Encode only the implication directions required to assert the edge.
+    // Return solver literal, encoded as 2*svar + sign
+    int pog_encode(int edge);
+    // Get solver literal for POG literal, creating solver variable if needed
+    int pog_solver_lit(int lit);
 };
@@ -32,23 +32,25 @@ typedef enum {
 
     COUNT_UNUSED_VAR, COUNT_DATA_VAR, COUNT_NONTSEITIN_VAR, COUNT_TSEITIN_DETECT_VAR, COUNT_TSEITIN_PROMOTE_VAR, COUNT_ELIM_VAR,
     COUNT_INPUT_CLAUSE, 
-    COUNT_BVE_ELIM_CLAUSE, COUNT_BVE_NEW_CLAUSE,
-    COUNT_PROMOTE_CLAUSE,
-    COUNT_TSEITIN_TEST,
+    COUNT_BVE_ELIM_CLAUSE, COUNT_BVE_NEW_CLAUSE, COUNT_BVE_SUBSUME_CLAUSE, COUNT_BVE_STRENGTHEN_CLAUSE, COUNT_BVE_HEAP_OP, COUNT_BVE_GATE_VAR,
+    COUNT_PROMOTE_CLAUSE, COUNT_PROMOTE_AUX_VAR,
+    COUNT_TSEITIN_TEST, COUNT_TSEITIN_GATE_DETECT, COUNT_TSEITIN_SAT_DETECT,
     COUNT_POG_INITIAL_PRODUCT, COUNT_POG_INITIAL_SUM, COUNT_POG_INITIAL_EDGES,
     COUNT_POG_FINAL_PRODUCT, COUNT_POG_FINAL_SUM, COUNT_POG_FINAL_EDGES,
     COUNT_POG_PRODUCT, COUNT_POG_SUM, COUNT_POG_EDGES,
     COUNT_VISIT_PRODUCT,
     COUNT_VISIT_DATA_SUM, COUNT_VISIT_TAUTOLOGY_SUM, COUNT_VISIT_MUTEX_SUM,
     COUNT_VISIT_EXCLUDING_SUM, COUNT_VISIT_SUBSUMED_SUM, COUNT_VISIT_COUNTED_SUM,
-    COUNT_SAT_CALL, COUNT_BUILTIN_KC,  COUNT_KC_CALL,
+    COUNT_SAT_CALL, COUNT_MICROSAT_CALL, COUNT_BUILTIN_KC,  COUNT_KC_CALL,
     COUNT_PKC_DATA_ONLY, COUNT_PKC_PROJECT_ONLY, COUNT_PKC_REUSE,
+    COUNT_SIM_QUERY, COUNT_SIM_HIT, COUNT_SIM_EXTRA_HIT, COUNT_TRUTH_TABLE_SAT, COUNT_TRUTH_TABLE_COUNT,
+    COUNT_DETERMINISTIC_TEST,
     COUNT_NUM
 } counter_t;
 
 typedef enum { TIME_PREPROCESS, TIME_SAT, TIME_BCP, TIME_CLASSIFY, TIME_KC, TIME_BUILTIN_KC, TIME_INITIAL_KC, TIME_RING_EVAL, TIME_NUM } runtimer_t;
 
-typedef enum { HISTO_SAT_CLAUSES, HISTO_KC_CLAUSES, HISTO_BUILTIN_KC_CLAUSES, HISTO_POG_NODES, HISTO_NUM } histogram_t;
+typedef enum { HISTO_SAT_CLAUSES, HISTO_SAT_POLARITY_SAVED, HISTO_MICROSAT_CLAUSES, HISTO_KC_CLAUSES, HISTO_BUILTIN_KC_CLAUSES, HISTO_POG_NODES, HISTO_NUM } histogram_t;
 
 /* Allow this headerfile to define C++ constructs if requested */
 #ifdef __cplusplus
@@ -0,0 +1,135 @@
+/*========================================================================
+  Copyright (c) 2023 Randal E. Bryant, Carnegie Mellon University
+  
+  Permission is hereby granted, free of
+  charge, to any person obtaining a copy of this software and
+  associated documentation files (the "Software"), to deal in the
+  Software without restriction, including without limitation the
+  rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom
+  the Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+========================================================================*/
+
+
+#include <cstring>
+#include "microsat.hh"
+
+void Microsat::clear() {
+    variable_count = 0;
+    memset(table_var, 0, sizeof(table_var));
+    positive.clear();
+    negative.clear();
+    empty_clause = false;
+}
+
+int Microsat::variable_index(int var) {
+    int size = 2*MICROSAT_MAX_VARIABLE;
+    int h = (unsigned) var * 2654435761u % size;
+    while (table_var[h] != 0) {
+	if (table_var[h] == var)
+	    return table_index[h];
+	h = (h+1) % size;
+    }
+    if (variable_count == MICROSAT_MAX_VARIABLE)
+	return -1;
+    table_var[h] = var;
+    table_index[h] = variable_count;
+    return variable_count++;
+}
+
+bool Microsat::add_clause(const int *lits, int len) {
+    if (positive.size() == MICROSAT_MAX_CLAUSE)
+	return false;
+    uint64_t pmask = 0;
+    uint64_t nmask = 0;
+    for (int i = 0; i < len; i++) {
+	int lit = lits[i];
+	int idx = variable_index(lit > 0 ? lit : -lit);
+	if (idx < 0)
+	    return false;
+	if (lit > 0)
+	    pmask |= (uint64_t) 1 << idx;
+	else
+	    nmask |= (uint64_t) 1 << idx;
+    }
+    if (pmask & nmask)
+	// Tautology
+	return true;
+    if (pmask == 0 && nmask == 0)
+	empty_clause = true;
+    positive.push_back(pmask);
+    negative.push_back(nmask);
+    return true;
+}
+
+bool Microsat::search(uint64_t true_mask, uint64_t false_mask) {
+    int nclause = positive.size();
+    // Unassigned literals of the first clause that is neither satisfied nor unit
+    uint64_t branch_positive = 0;
+    uint64_t branch_negative = 0;
+    bool changed = true;
+    while (changed) {
+	changed = false;
+	branch_positive = branch_negative = 0;
+	uint64_t assigned = true_mask | false_mask;
+	for (int i = 0; i < nclause; i++) {
+	    if ((positive[i] & true_mask) | (negative[i] & false_mask))
+		continue;
+	    uint64_t upos = positive[i] & ~assigned;
+	    uint64_t uneg = negative[i] & ~assigned;
+	    uint64_t unassigned = upos | uneg;
+	    if (unassigned == 0)
+		// Conflict
+		return false;
+	    if ((unassigned & (unassigned-1)) == 0) {
+		// Unit clause
+		if (upos)
+		    true_mask |= upos;
+		else
+		    false_mask |= uneg;
+		assigned |= unassigned;
+		changed = true;
+	    } else if (branch_positive == 0 && branch_negative == 0) {
+		branch_positive = upos;
+		branch_negative = uneg;
+	    }
+	}
+    }
+    if (branch_positive == 0 && branch_negative == 0)
+	// All clauses satisfied
+	return true;
+    if (++decision_count > decision_limit)
+	return false;
+    // Branch on literal of clause, first trying to satisfy it
+    if (branch_positive) {
+	uint64_t bit = branch_positive & -branch_positive;
+	return search(true_mask | bit, false_mask) || (decision_count <= decision_limit && search(true_mask, false_mask | bit));
+    } else {
+	uint64_t bit = branch_negative & -branch_negative;
+	return search(true_mask, false_mask | bit) || (decision_count <= decision_limit && search(true_mask | bit, false_mask));
+    }
+}
+
+microsat_result_t Microsat::solve(long limit) {
+    if (empty_clause)
+	return MICROSAT_UNSAT;
+    decision_count = 0;
+    decision_limit = limit;
+    bool sat = search(0, 0);
+    if (sat)
+	return MICROSAT_SAT;
+    return decision_count > decision_limit ? MICROSAT_UNKNOWN : MICROSAT_UNSAT;
+}
@@ -0,0 +1,71 @@
+/*========================================================================
+  Copyright (c) 2023 Randal E. Bryant, Carnegie Mellon University
+  
+  Permission is hereby granted, free of
+  charge, to any person obtaining a copy of this software and
+  associated documentation files (the "Software"), to deal in the
+  Software without restriction, including without limitation the
+  rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom
+  the Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+========================================================================*/
+
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+// Largest problems handed to the bit-parallel solver
+#define MICROSAT_MAX_VARIABLE 64
+#define MICROSAT_MAX_CLAUSE 256
+// Give up after this many decisions.  Caller then uses a complete solver
+#define MICROSAT_DECISION_LIMIT 10000
+
+typedef enum { MICROSAT_UNSAT, MICROSAT_SAT, MICROSAT_UNKNOWN } microsat_result_t;
+
+// DPLL solver for problems with at most 64 variables.
+// Each clause is represented by bit masks of its positive and negative literals,
+// so that unit propagation examines all literals of a clause at once
+class Microsat {
+private:
+    int variable_count;
+    // Open-addressed table mapping variables to bit positions.  Holds 1 + position, or 0 when empty
+    int table_var[2*MICROSAT_MAX_VARIABLE];
+    int table_index[2*MICROSAT_MAX_VARIABLE];
+    // Clause masks
+    std::vector<uint64_t> positive;
+    std::vector<uint64_t> negative;
+    // Problem contains empty clause
+    bool empty_clause;
+    long decision_count;
+    long decision_limit;
+
+    // Return bit position for variable, or -1 if no room
+    int variable_index(int var);
+    // Extend assignment to satisfy clauses.  Return false if no solution found
+    bool search(uint64_t true_mask, uint64_t false_mask);
+
+public:
+    Microsat() { clear(); }
+
+    void clear();
+    // Add clause given as array of nonzero literals.
+    // Returns false if problem becomes too large
+    bool add_clause(const int *lits, int len);
+    int clause_count() { return positive.size(); }
+    microsat_result_t solve(long limit);
+};
@@ -0,0 +1,166 @@
+/*========================================================================
+  Copyright (c) 2023 Randal E. Bryant, Carnegie Mellon University
+  
+  Permission is hereby granted, free of
+  charge, to any person obtaining a copy of this software and
+  associated documentation files (the "Software"), to deal in the
+  Software without restriction, including without limitation the
+  rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom
+  the Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+========================================================================*/
+
+
+// Measure throughput of the two DIMACS input paths:
+// stdio-based Cnf::import_file and memory-mapped Cnf::import_reader.
+// Also checks that both produce identical CNF representations
+
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+#include "report.h"
+#include "compile.hh"
+#include "reader.hh"
+
+static void usage(const char *name) {
+    lprintf("Usage: %s [-h] [-r REPS] FILE.cnf ...\n", name);
+    lprintf("  -h          Print this information\n");
+    lprintf("  -r REPS     Number of times to parse each file (default 3)\n");
+}
+
+// Return true if two CNFs have same header, clauses, data variables, and weights
+static bool same_cnf(Cnf &cnf1, Cnf &cnf2) {
+    if (cnf1.variable_count() != cnf2.variable_count())
+	return false;
+    if (cnf1.maximum_clause_id() != cnf2.maximum_clause_id())
+	return false;
+    for (int cid = 1; cid <= cnf1.maximum_clause_id(); cid++) {
+	int len = cnf1.clause_length(cid);
+	if (len != cnf2.clause_length(cid))
+	    return false;
+	for (int lid = 0; lid < len; lid++)
+	    if (cnf1.get_literal(cid, lid) != cnf2.get_literal(cid, lid))
+		return false;
+    }
+    if (*cnf1.data_variables != *cnf2.data_variables)
+	return false;
+    if (cnf1.input_weights->size() != cnf2.input_weights->size())
+	return false;
+    for (auto kv : *cnf1.input_weights) {
+	auto fid = cnf2.input_weights->find(kv.first);
+	if (fid == cnf2.input_weights->end() || q25_compare(kv.second, fid->second) != 0)
+	    return false;
+    }
+    return true;
+}
+
+// Parse file with stdio.  Return elapsed time, or negative if failed
+static double parse_stdio(const char *fname, Cnf &cnf) {
+    double start = tod();
+    FILE *infile = fopen(fname, "r");
+    if (!infile)
+	return -1.0;
+    bool ok = cnf.import_file(infile, true);
+    fclose(infile);
+    return ok ? tod() - start : -1.0;
+}
+
+// Parse memory-mapped file.  Return elapsed time, or negative if failed
+static double parse_mmap(const char *fname, Cnf &cnf) {
+    double start = tod();
+    Reader in;
+    if (!in.open(fname))
+	return -1.0;
+    bool ok = cnf.import_reader(in, true);
+    if (!in.close())
+	ok = false;
+    return ok ? tod() - start : -1.0;
+}
+
+int main(int argc, char *const argv[]) {
+    int reps = 3;
+    int c;
+    while ((c = getopt(argc, argv, "hr:")) != -1) {
+	switch (c) {
+	case 'h':
+	    usage(argv[0]);
+	    return 0;
+	case 'r':
+	    reps = atoi(optarg);
+	    break;
+	default:
+	    usage(argv[0]);
+	    return 1;
+	}
+    }
+    if (optind >= argc || reps < 1) {
+	usage(argv[0]);
+	return 1;
+    }
+    verblevel = 1;
+    double total_mb = 0.0;
+    double total_stdio = 0.0;
+    double total_mmap = 0.0;
+    int mismatches = 0;
+    lprintf("%-40s %10s %10s %10s %10s\n", "File", "MB", "stdio MB/s", "mmap MB/s", "Match");
+    for (int argi = optind; argi < argc; argi++) {
+	const char *fname = argv[argi];
+	Reader probe;
+	if (!probe.open(fname)) {
+	    err(false, "Couldn't open file '%s'\n", fname);
+	    continue;
+	}
+	double mb = probe.remaining() / (1024.0 * 1024.0);
+	probe.close();
+	// Use best time over repetitions
+	double best_stdio = 0.0;
+	double best_mmap = 0.0;
+	bool match = true;
+	bool ok = true;
+	for (int r = 0; ok && r < reps; r++) {
+	    Cnf cnf_stdio, cnf_mmap;
+	    double t_stdio = parse_stdio(fname, cnf_stdio);
+	    double t_mmap = parse_mmap(fname, cnf_mmap);
+	    if (t_stdio < 0 || t_mmap < 0)
+		ok = false;
+	    else {
+		if (r == 0 || t_stdio < best_stdio)
+		    best_stdio = t_stdio;
+		if (r == 0 || t_mmap < best_mmap)
+		    best_mmap = t_mmap;
+		if (r == 0)
+		    match = same_cnf(cnf_stdio, cnf_mmap);
+	    }
+	    cnf_stdio.deallocate();
+	    cnf_mmap.deallocate();
+	}
+	if (!ok) {
+	    err(false, "Couldn't parse file '%s'\n", fname);
+	    continue;
+	}
+	if (!match)
+	    mismatches++;
+	total_mb += mb;
+	total_stdio += best_stdio;
+	total_mmap += best_mmap;
+	lprintf("%-40s %10.2f %10.2f %10.2f %10s\n", fname, mb, mb/best_stdio, mb/best_mmap, match ? "yes" : "NO");
+    }
+    if (total_stdio > 0 && total_mmap > 0)
+	lprintf("%-40s %10.2f %10.2f %10.2f %10s\n", "TOTAL", total_mb, total_mb/total_stdio, total_mb/total_mmap,
+		mismatches == 0 ? "yes" : "NO");
+    return mismatches == 0 ? 0 : 1;
+}
@@ -35,7 +35,7 @@
 
 
 void usage(const char *name) {
-    lprintf("Usage: %s [-h] [-m i|t|m|d|c|p] [-P PRE] [-T n|d|p] [-k] [-1] [-v VERB] [-L LOG] [-O OPT] [-b BLIM] FORMULA.cnf [FORMULA.pog]\n", name);
+    lprintf("Usage: %s [-h] [-m i|t|m|d|c|p] [-P PRE] [-T n|d|p] [-k] [-1] [-v VERB] [-L LOG] [-O OPT] [-b BLIM] [-S SNAP] [-j THREADS] [-e PLIM] [-E PTOT] [-G] FORMULA.cnf [FORMULA.pog]\n", name);
     lprintf("  -h          Print this information\n");
     lprintf("  -m          Select mode: i: incremental, t: trim, m: monolithic, d: defer splitting on projection variables,\n");
     lprintf("                 c: compile without projection, p: stop after preprocessing\n");
@@ -47,6 +47,13 @@ void usage(const char *name) {
     lprintf("  -L LOG      Record all results to file LOG\n");
     lprintf("  -O OPT      Select optimization level (0 None, 1:+Reuse, 2:+Analyze vars, 3:+Built-in KC, 4:+Subsumption check)\n");
     lprintf("  -b BLIM     Set upper bound on size (in clauses) of problem for which use built-in KC\n");
+    lprintf("  -S SNAP     With -m p, write preprocessed formula to binary snapshot file SNAP.\n");
+    lprintf("                 Giving SNAP as FORMULA in a later run skips preprocessing\n");
+    lprintf("  -j THREADS  Use multiple threads for BVE and variable classification during preprocessing.  Result does not depend on number\n");
+    lprintf("  -e PLIM     Set upper bound on clauses added to promote a variable before using auxiliary variables\n");
+    lprintf("  -E PTOT     Set upper bound on total clauses added by Tseitin promotion\n");
+    lprintf("  -G          Use polarity-aware encoding for CNFs sent to D4 v2 when trimming\n");
+    lprintf("  FORMULA.cnf can be compressed (.gz, .xz, or .zst), or '-' to read from standard input\n");
 }
 
 // Program options
@@ -59,6 +66,11 @@ bool tseitin_promote = true;
 int trace_variable = 0;
 int bkc_limit = 70;
 bool use_d4v2 = true;
+const char *snapshot_name = NULL;
+int thread_count = 1;
+int promote_limit = 64;
+int promote_total_limit = 100000;
+bool polarity_kc = false;
 
 char pkc_mode_char[PKC_NUM] = {'i', 't', 'm', 'd', 'c', 'p'};
 const char *pkc_mode_descr[PKC_NUM] = {"incremental", "trim", "monolithic", "deferred", "compile", "preprocess" };
@@ -68,6 +80,28 @@ const char *prefix = "c PKC:";
 q25_ptr ucount = NULL;
 q25_ptr wcount = NULL;
 
+// SAT calls are split between Glucose and the bit-parallel solver for small problems
+static void sat_report() {
+    int sat_count = get_count(COUNT_SAT_CALL);
+    int micro_count = get_count(COUNT_MICROSAT_CALL);
+    lprintf("%s SAT calls\n", prefix);
+    lprintf("%s    SAT TOTAL              : %d\n", prefix, sat_count);
+    if (sat_count > micro_count) {
+	lprintf("%s    Glucose calls          : %d\n", prefix, sat_count - micro_count);
+	lprintf("%s    SAT Clause MIN         : %d\n", prefix, get_histo_min(HISTO_SAT_CLAUSES));
+	lprintf("%s    SAT Clause AVG         : %.2f\n", prefix, get_histo_avg(HISTO_SAT_CLAUSES));
+	lprintf("%s    SAT Clause MAX         : %d\n", prefix, get_histo_max(HISTO_SAT_CLAUSES));
+	if (get_histo_max(HISTO_SAT_POLARITY_SAVED) > 0)
+	    lprintf("%s    Polarity saved AVG     : %.2f\n", prefix, get_histo_avg(HISTO_SAT_POLARITY_SAVED));
+    }
+    if (micro_count > 0) {
+	lprintf("%s    Micro solver calls     : %d\n", prefix, micro_count);
+	lprintf("%s    MSAT Clause MIN        : %d\n", prefix, get_histo_min(HISTO_MICROSAT_CLAUSES));
+	lprintf("%s    MSAT Clause AVG        : %.2f\n", prefix, get_histo_avg(HISTO_MICROSAT_CLAUSES));
+	lprintf("%s    MSAT Clause MAX        : %d\n", prefix, get_histo_max(HISTO_MICROSAT_CLAUSES));
+    }
+}
+
 static void stat_report(double elapsed) {
     if (verblevel < 1)
 	return;
@@ -78,12 +112,15 @@ static void stat_report(double elapsed) {
     int tdv = get_count(COUNT_TSEITIN_DETECT_VAR);
     int tpv = get_count(COUNT_TSEITIN_PROMOTE_VAR);
     int ev = get_count(COUNT_ELIM_VAR);
-    lprintf("%s    Declared Variables     : %d\n", prefix, uv+dv+ntv+tdv+tpv+ev);
+    int av = get_count(COUNT_PROMOTE_AUX_VAR);
+    lprintf("%s    Declared Variables     : %d\n", prefix, uv+dv+ntv+tdv+tpv+ev-av);
     lprintf("%s    Data variables         : %d\n", prefix, dv);
     lprintf("%s    Eliminated variables   : %d\n", prefix, ev);
     lprintf("%s    Tseitin variables:\n", prefix);
     lprintf("%s       Tseitin original    : %d\n", prefix, tdv);
     lprintf("%s       Tseitin promoted    : %d\n", prefix, tpv);
+    if (av > 0)
+	lprintf("%s         (auxiliary)       : %d\n", prefix, av);
     lprintf("%s       Tseitin TOTAL       : %d\n", prefix, tdv+tpv);
     lprintf("%s    Other projection vars  : %d\n", prefix, ntv);
     lprintf("%s    Unused vars            : %d\n", prefix, uv);
@@ -92,26 +129,23 @@ static void stat_report(double elapsed) {
     int pc = get_count(COUNT_PROMOTE_CLAUSE);
     int ec = get_count(COUNT_BVE_ELIM_CLAUSE);
     int nc = get_count(COUNT_BVE_NEW_CLAUSE);
+    int sc = get_count(COUNT_BVE_SUBSUME_CLAUSE);
     lprintf("%s       Input clauses       : %d\n", prefix, ic);
     lprintf("%s       BVE Elim clauses    : %d\n", prefix, ec);
     lprintf("%s       BVE Added clauses   : %d\n", prefix, nc);
+    lprintf("%s       BVE Subsumed clauses: %d\n", prefix, sc);
+    lprintf("%s       BVE Strengthened    : %d\n", prefix, get_count(COUNT_BVE_STRENGTHEN_CLAUSE));
     lprintf("%s       Promoting clauses   : %d\n", prefix, pc);
-    lprintf("%s       Clause TOTAL        : %d\n", prefix, ic-ec+nc+pc);
+    lprintf("%s       Clause TOTAL        : %d\n", prefix, ic-ec+nc-sc+pc);
     lprintf("%s Preprocessing\n", prefix);
     lprintf("%s   Tseitin variable tests:   %d\n", prefix, get_count(COUNT_TSEITIN_TEST));
+    lprintf("%s     Detected by gate match: %d\n", prefix, get_count(COUNT_TSEITIN_GATE_DETECT));
+    lprintf("%s     Detected by SAT test:   %d\n", prefix, get_count(COUNT_TSEITIN_SAT_DETECT));
+    lprintf("%s   BVE heap operations:      %d\n", prefix, get_count(COUNT_BVE_HEAP_OP));
+    lprintf("%s   BVE gate eliminations:    %d\n", prefix, get_count(COUNT_BVE_GATE_VAR));
 
     if (mode == PKC_PREPROCESS) {
-	int sat_count = get_count(COUNT_SAT_CALL);
-	int clause_min = get_histo_min(HISTO_SAT_CLAUSES);
-	int clause_max = get_histo_max(HISTO_SAT_CLAUSES);
-	double clause_avg = get_histo_avg(HISTO_SAT_CLAUSES);
-	lprintf("%s SAT calls\n", prefix);
-	lprintf("%s    SAT TOTAL              : %d\n", prefix, sat_count);
-	if (sat_count > 0) {
-	    lprintf("%s    SAT Clause MIN         : %d\n", prefix, clause_min);
-	    lprintf("%s    SAT Clause AVG         : %.2f\n", prefix, clause_avg);
-	    lprintf("%s    SAT Clause MAX         : %d\n", prefix, clause_max);
-	}
+	sat_report();
 	double preprocess_time = get_timer(TIME_PREPROCESS);
 	double sat_time = get_timer(TIME_SAT);
 	double classify_time = get_timer(TIME_CLASSIFY)-sat_time;
@@ -149,25 +183,13 @@ static void stat_report(double elapsed) {
     lprintf("%s    Final POG Clauses      : %ld\n", prefix, ps+pp+pe);
 
     
-    int sat_count = get_count(COUNT_SAT_CALL);
-    int clause_min = get_histo_min(HISTO_SAT_CLAUSES);
-    int clause_max = get_histo_max(HISTO_SAT_CLAUSES);
-    double clause_avg = get_histo_avg(HISTO_SAT_CLAUSES);
-
-    if (mode == PKC_INCREMENTAL || mode == PKC_DEFERRED) {
-	lprintf("%s SAT calls\n", prefix);
-	lprintf("%s    SAT TOTAL              : %d\n", prefix, sat_count);
-	if (sat_count > 0) {
-	    lprintf("%s    SAT Clause MIN         : %d\n", prefix, clause_min);
-	    lprintf("%s    SAT Clause AVG         : %.2f\n", prefix, clause_avg);
-	    lprintf("%s    SAT Clause MAX         : %d\n", prefix, clause_max);
-	}
-    }
+    if (mode == PKC_INCREMENTAL || mode == PKC_DEFERRED)
+	sat_report();
 
     int kc_count = get_count(COUNT_KC_CALL);
-    clause_min = get_histo_min(HISTO_KC_CLAUSES);
-    clause_max = get_histo_max(HISTO_KC_CLAUSES);
-    clause_avg = get_histo_avg(HISTO_KC_CLAUSES);
+    int clause_min = get_histo_min(HISTO_KC_CLAUSES);
+    int clause_max = get_histo_max(HISTO_KC_CLAUSES);
+    double clause_avg = get_histo_avg(HISTO_KC_CLAUSES);
     lprintf("%s External KC calls\n", prefix);
     lprintf("%s    External KC TOTAL      : %d\n", prefix, kc_count);
     if (kc_count > 0) {
@@ -217,6 +239,16 @@ static void stat_report(double elapsed) {
 	lprintf("%s    Only data variables    : %d\n", prefix, get_count(COUNT_PKC_DATA_ONLY));
 	lprintf("%s    Only projection vars   : %d\n", prefix, get_count(COUNT_PKC_PROJECT_ONLY));
 	lprintf("%s    Result reuse           : %d\n", prefix, get_count(COUNT_PKC_REUSE));
+	int sq = get_count(COUNT_SIM_QUERY);
+	int sh = get_count(COUNT_SIM_HIT);
+	lprintf("%s    Simulation queries     : %d\n", prefix, sq);
+	if (sq > 0)
+	    lprintf("%s    Simulation hits        : %d (%.1f%%)\n", prefix, sh, 100.0 * sh / sq);
+	if (sh > 0)
+	    lprintf("%s      In later rounds      : %d\n", prefix, get_count(COUNT_SIM_EXTRA_HIT));
+	lprintf("%s    Truth table SAT tests  : %d\n", prefix, get_count(COUNT_TRUTH_TABLE_SAT));
+	lprintf("%s    Truth table counts     : %d\n", prefix, get_count(COUNT_TRUTH_TABLE_COUNT));
+	lprintf("%s    Count-based tests      : %d\n", prefix, get_count(COUNT_DETERMINISTIC_TEST));
     }
 
     double preprocess_time = get_timer(TIME_PREPROCESS);
@@ -240,7 +272,7 @@ static void stat_report(double elapsed) {
 }
 
 static int run(double start, const char *cnf_name, const char *pog_name) {
-    Project proj(cnf_name, mode, use_d4v2, preprocess_level, tseitin_detect, tseitin_promote, optlevel, bkc_limit);
+    Project proj(cnf_name, mode, use_d4v2, preprocess_level, tseitin_detect, tseitin_promote, optlevel, bkc_limit, snapshot_name, thread_count, promote_limit, promote_total_limit, polarity_kc);
     if (mode == PKC_PREPROCESS)
 	return 0;
     if (trace_variable != 0)
@@ -269,7 +301,7 @@ int main(int argc, char *const argv[]) {
     int nbkc_limit = bkc_limit;
     int c;
     char flag;
-    while ((c = getopt(argc, argv, "hkP:T:1m:v:L:O:b:")) != -1) {
+    while ((c = getopt(argc, argv, "hkP:T:1m:v:L:O:b:S:j:e:E:G")) != -1) {
 	switch (c) {
 	case 'h':
 	    usage(argv[0]);
@@ -328,6 +360,21 @@ int main(int argc, char *const argv[]) {
 	case 'b':
 	    nbkc_limit = atoi(optarg);
 	    break;
+	case 'S':
+	    snapshot_name = optarg;
+	    break;
+	case 'j':
+	    thread_count = atoi(optarg);
+	    break;
+	case 'e':
+	    promote_limit = atoi(optarg);
+	    break;
+	case 'E':
+	    promote_total_limit = atoi(optarg);
+	    break;
+	case 'G':
+	    polarity_kc = true;
+	    break;
 	default:
 	    lprintf("Unknown commandline option '%c'\n", c);
 	    usage(argv[0]);
@@ -337,6 +384,11 @@ int main(int argc, char *const argv[]) {
     }
     // Set this when all options declared
     bkc_limit = nbkc_limit;
+    if (snapshot_name && mode != PKC_PREPROCESS) {
+	lprintf("Can only write snapshot in preprocessing mode (-m p)\n");
+	usage(argv[0]);
+	return 1;
+    }
     int argi = optind;
     if (argi >= argc) {
 	lprintf("Name of input CNF file required\n");
@@ -367,6 +419,14 @@ int main(int argc, char *const argv[]) {
     lprintf("%s   Tseitin variable handling %s\n", prefix, tseitin_mode);
     lprintf("%s   Optimization level        %d\n", prefix, optlevel);
     lprintf("%s   Builtin KC limit          %d\n", prefix, bkc_limit);
+    if (snapshot_name)
+	lprintf("%s   Snapshot file             %s\n", prefix, snapshot_name);
+    if (thread_count > 1)
+	lprintf("%s   Threads                   %d\n", prefix, thread_count);
+    if (tseitin_promote)
+	lprintf("%s   Promotion clause limits   %d / %d\n", prefix, promote_limit, promote_total_limit);
+    if (polarity_kc)
+	lprintf("%s   Polarity-aware KC input   %s\n", prefix, use_d4v2 ? "yes" : "no (requires D4 v2)");
     if (trace_variable != 0)
 	lprintf("%s   Trace variable            %d\n", prefix, trace_variable);
     double start = tod();
@@ -390,6 +390,33 @@ int Pog::get_decision_variable(int edge) {
     return 0;
 }
 
+bool Pog::is_decision(int nidx) {
+    if (nodes[nidx].degree != 2)
+	return false;
+    int *args = &arguments[nodes[nidx].offset];
+    // Top-level literals of each argument.  Only positive product edges expose their arguments
+    int n[2];
+    int *lits[2];
+    for (int i = 0; i < 2; i++) {
+	if (is_node(args[i]) && args[i] > 0 && get_type(args[i]) == POG_PRODUCT) {
+	    n[i] = get_degree(args[i]);
+	    lits[i] = get_arguments(args[i]);
+	} else {
+	    n[i] = 1;
+	    lits[i] = &args[i];
+	}
+    }
+    for (int i0 = 0; i0 < n[0]; i0++)
+	for (int i1 = 0; i1 < n[1]; i1++)
+	    if (lits[0][i0] == -lits[1][i1])
+		return true;
+    return false;
+}
+
+void Pog::set_exclusive() {
+    exclusive_arguments = true;
+}
+
 void Pog::start_node(pog_type_t type) {
     if (type != POG_PRODUCT && type != POG_SUM)
 	err(true, "Trying to create node of unknown type %d\n", (int) type);
@@ -401,6 +428,8 @@ void Pog::start_node(pog_type_t type) {
     nodes[nidx].degree = 0;
     nodes[nidx].data_only = true;
     nodes[nidx].projection_only = true;
+    nodes[nidx].deterministic = true;
+    exclusive_arguments = false;
 }
 
 void Pog::add_argument(int edge) {
@@ -433,6 +462,7 @@ void Pog::add_argument(int edge) {
     }
     nodes[nidx].data_only = nodes[nidx].data_only && only_data_variables(edge);
     nodes[nidx].projection_only = nodes[nidx].projection_only && only_projection_variables(edge);
+    nodes[nidx].deterministic = nodes[nidx].deterministic && is_deterministic(edge);
     // Merge arguments to product operation
     if (is_node(edge) && type == POG_PRODUCT && get_type(edge) == POG_PRODUCT && get_phase(edge)) {
 	int edegree = get_degree(edge);
@@ -463,6 +493,8 @@ int Pog::finish_node() {
     } else {
 	// Order arguments
 	std::sort(arguments.end()-degree, arguments.end(), abs_less);
+	if (type == POG_SUM)
+	    nodes[nidx].deterministic = nodes[nidx].deterministic && (exclusive_arguments || is_decision(nidx));
 	// Look in hash table
 	edge = nidx + nvar + 1;
 	unsigned h = node_hash(edge);
@@ -470,6 +502,9 @@ int Pog::finish_node() {
 	for (auto iter = bucket.first; iter != bucket.second; iter++) {
 	    int oedge = iter->second;
 	    if (node_equal(edge, oedge)) {
+		// Existing node has same arguments, and so it is deterministic if this one is
+		if (nodes[nidx].deterministic)
+		    nodes[node_index(oedge)].deterministic = true;
 		edge = oedge;
 		retract = true;
 	    }
@@ -629,6 +664,369 @@ void Pog::get_subgraph(std::vector<int> &root_edges, std::map<int,int> &node_rem
     }
 }
 
+// Simulation support
+
+// Fixed seed, so that results are reproducible
+static uint64_t sim_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t sim_random() {
+    // xorshift64*
+    sim_state ^= sim_state >> 12;
+    sim_state ^= sim_state << 25;
+    sim_state ^= sim_state >> 27;
+    return sim_state * 0x2545F4914F6CDD1Dull;
+}
+
+static uint64_t sim_all_ones[SIM_WORDS];
+
+uint64_t *Pog::sim_words(int edge) {
+    int var = get_var(edge);
+    if (var == TAUTOLOGY)
+	return sim_all_ones;
+    if (is_node(var))
+	return &sim_signature[node_index(var) * SIM_WORDS];
+    return &sim_input[var * SIM_WORDS];
+}
+
+void Pog::simulate_extend() {
+    if (sim_input.size() == 0) {
+	for (int w = 0; w < SIM_WORDS; w++)
+	    sim_all_ones[w] = ~0ull;
+	sim_input.resize((nvar+1) * SIM_WORDS);
+	for (int i = SIM_WORDS; i < sim_input.size(); i++)
+	    sim_input[i] = sim_random();
+    }
+    int ncount = nodes.size();
+    if (sim_node_count >= ncount)
+	return;
+    sim_signature.resize(ncount * SIM_WORDS);
+    // Arguments always precede their node
+    for (int nidx = sim_node_count; nidx < ncount; nidx++) {
+	uint64_t *result = &sim_signature[nidx * SIM_WORDS];
+	bool is_sum = nodes[nidx].type == POG_SUM;
+	for (int w = 0; w < SIM_WORDS; w++)
+	    result[w] = is_sum ? 0 : ~0ull;
+	int degree = nodes[nidx].degree;
+	int *args = &arguments[nodes[nidx].offset];
+	for (int i = 0; i < degree; i++) {
+	    uint64_t *words = sim_words(args[i]);
+	    uint64_t mask = args[i] < 0 ? ~0ull : 0;
+	    if (is_sum)
+		for (int w = 0; w < SIM_WORDS; w++)
+		    result[w] |= words[w] ^ mask;
+	    else
+		for (int w = 0; w < SIM_WORDS; w++)
+		    result[w] &= words[w] ^ mask;
+	}
+    }
+    sim_node_count = ncount;
+}
+
+bool Pog::simulate_satisfiable(std::vector<int> &edges) {
+    simulate_extend();
+    uint64_t conjunction[SIM_WORDS];
+    for (int w = 0; w < SIM_WORDS; w++)
+	conjunction[w] = ~0ull;
+    for (int edge : edges) {
+	uint64_t *words = sim_words(edge);
+	uint64_t mask = edge < 0 ? ~0ull : 0;
+	for (int w = 0; w < SIM_WORDS; w++)
+	    conjunction[w] &= words[w] ^ mask;
+    }
+    for (int w = 0; w < SIM_WORDS; w++)
+	if (conjunction[w] != 0)
+	    return true;
+    if (SIM_ROUNDS <= 1)
+	return false;
+    // Collect cone of the edges for the later rounds
+    if (sim_position.size() < nodes.size())
+	sim_position.resize(nodes.size(), -1);
+    std::vector<int> cone;
+    std::vector<int> stack;
+    for (int edge : edges) {
+	int nidx = node_index(edge);
+	if (nidx >= 0 && sim_position[nidx] < 0) {
+	    sim_position[nidx] = 0;
+	    stack.push_back(nidx);
+	}
+    }
+    while (stack.size() > 0) {
+	int nidx = stack.back();
+	stack.pop_back();
+	cone.push_back(nidx);
+	int degree = nodes[nidx].degree;
+	int *args = &arguments[nodes[nidx].offset];
+	for (int i = 0; i < degree; i++) {
+	    int cidx = node_index(args[i]);
+	    if (cidx >= 0 && sim_position[cidx] < 0) {
+		sim_position[cidx] = 0;
+		stack.push_back(cidx);
+	    }
+	}
+    }
+    // Arguments always precede their node
+    std::sort(cone.begin(), cone.end());
+    for (int pos = 0; pos < cone.size(); pos++)
+	sim_position[cone[pos]] = pos;
+    sim_cone_signature.resize(cone.size() * SIM_WORDS);
+    bool found = false;
+    for (int round = 1; !found && round < SIM_ROUNDS; round++)
+	found = simulate_round(edges, cone, round);
+    for (int nidx : cone)
+	sim_position[nidx] = -1;
+    if (found)
+	incr_count(COUNT_SIM_EXTRA_HIT);
+    return found;
+}
+
+// Input patterns for later rounds are generated from variable, round, and word,
+// rather than being stored.  Uses splitmix64 finalizer
+static uint64_t sim_pattern(int var, int round, int w) {
+    uint64_t z = (((uint64_t) var * SIM_ROUNDS + round) * SIM_WORDS + w) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+const uint64_t *Pog::sim_round_words(int edge, int round, uint64_t *scratch) {
+    int var = get_var(edge);
+    if (var == TAUTOLOGY)
+	return sim_all_ones;
+    if (is_node(var))
+	return &sim_cone_signature[sim_position[node_index(var)] * SIM_WORDS];
+    for (int w = 0; w < SIM_WORDS; w++)
+	scratch[w] = sim_pattern(var, round, w);
+    return scratch;
+}
+
+bool Pog::simulate_round(std::vector<int> &edges, std::vector<int> &cone, int round) {
+    uint64_t scratch[SIM_WORDS];
+    for (int pos = 0; pos < cone.size(); pos++) {
+	int nidx = cone[pos];
+	uint64_t *result = &sim_cone_signature[pos * SIM_WORDS];
+	bool is_sum = nodes[nidx].type == POG_SUM;
+	for (int w = 0; w < SIM_WORDS; w++)
+	    result[w] = is_sum ? 0 : ~0ull;
+	int degree = nodes[nidx].degree;
+	int *args = &arguments[nodes[nidx].offset];
+	for (int i = 0; i < degree; i++) {
+	    const uint64_t *words = sim_round_words(args[i], round, scratch);
+	    uint64_t mask = args[i] < 0 ? ~0ull : 0;
+	    if (is_sum)
+		for (int w = 0; w < SIM_WORDS; w++)
+		    result[w] |= words[w] ^ mask;
+	    else
+		for (int w = 0; w < SIM_WORDS; w++)
+		    result[w] &= words[w] ^ mask;
+	}
+    }
+    uint64_t conjunction[SIM_WORDS];
+    for (int w = 0; w < SIM_WORDS; w++)
+	conjunction[w] = ~0ull;
+    for (int edge : edges) {
+	const uint64_t *words = sim_round_words(edge, round, scratch);
+	uint64_t mask = edge < 0 ? ~0ull : 0;
+	for (int w = 0; w < SIM_WORDS; w++)
+	    conjunction[w] &= words[w] ^ mask;
+    }
+    for (int w = 0; w < SIM_WORDS; w++)
+	if (conjunction[w] != 0)
+	    return true;
+    return false;
+}
+
+// Truth table support
+
+#define TT_UNKNOWN -1
+#define TT_LARGE -2
+
+static int tt_word_count(int k) {
+    return k <= 6 ? 1 : 1 << (k-6);
+}
+
+// Mask of valid bits in first word
+static uint64_t tt_mask(int k) {
+    return k >= 6 ? ~0ull : (1ull << (1 << k)) - 1;
+}
+
+// Re-express table over superset of its support, optionally complementing
+static void tt_expand(const truth_table &src, const std::vector<int> &support, bool negate, std::vector<uint64_t> &out) {
+    int k = support.size();
+    if (src.support == support)
+	out = src.bits;
+    else {
+	out.assign(tt_word_count(k), 0);
+	// Split minterm into low and high bytes to get source minterm by table lookup
+	unsigned lo[256], hi[256];
+	unsigned contrib[TT_MAX_VARS];
+	int j = 0;
+	for (int i = 0; i < k; i++) {
+	    contrib[i] = 0;
+	    if (j < src.support.size() && src.support[j] == support[i])
+		contrib[i] = 1u << j++;
+	}
+	for (int b = 0; b < 256; b++) {
+	    lo[b] = hi[b] = 0;
+	    for (int i = 0; i < 8; i++) {
+		if (b & (1 << i)) {
+		    if (i < k)
+			lo[b] += contrib[i];
+		    if (i+8 < k)
+			hi[b] += contrib[i+8];
+		}
+	    }
+	}
+	int nbits = 1 << k;
+	for (int m = 0; m < nbits; m++) {
+	    unsigned c = lo[m & 0xFF] + hi[m >> 8];
+	    if ((src.bits[c >> 6] >> (c & 63)) & 1)
+		out[m >> 6] |= 1ull << (m & 63);
+	}
+    }
+    if (negate)
+	for (int w = 0; w < out.size(); w++)
+	    out[w] = ~out[w];
+    out[0] &= tt_mask(k);
+}
+
+static int tt_popcount(const std::vector<uint64_t> &bits) {
+    int count = 0;
+    for (uint64_t w : bits)
+	count += __builtin_popcountll(w);
+    return count;
+}
+
+const truth_table *Pog::tt_find(int edge, truth_table &scratch) {
+    int var = get_var(edge);
+    if (!is_node(var)) {
+	scratch.support.clear();
+	scratch.bits.assign(1, 0x1);
+	if (var != TAUTOLOGY) {
+	    scratch.support.push_back(var);
+	    scratch.bits[0] = 0x2;
+	}
+	return &scratch;
+    }
+    if (tt_index.size() < nodes.size())
+	tt_index.resize(nodes.size(), TT_UNKNOWN);
+    std::vector<int> stack;
+    stack.push_back(node_index(var));
+    while (stack.size() > 0) {
+	int nidx = stack.back();
+	if (tt_index[nidx] != TT_UNKNOWN) {
+	    stack.pop_back();
+	    continue;
+	}
+	// Process arguments first
+	bool ready = true;
+	int degree = nodes[nidx].degree;
+	int *args = &arguments[nodes[nidx].offset];
+	for (int i = 0; i < degree; i++) {
+	    int cidx = node_index(args[i]);
+	    if (cidx >= 0 && tt_index[cidx] == TT_UNKNOWN) {
+		stack.push_back(cidx);
+		ready = false;
+	    }
+	}
+	if (!ready)
+	    continue;
+	stack.pop_back();
+	tt_index[nidx] = tt_compute(nidx);
+    }
+    int tidx = tt_index[node_index(var)];
+    return tidx < 0 ? NULL : &tt_tables[tidx];
+}
+
+int Pog::tt_compute(int nidx) {
+    int degree = nodes[nidx].degree;
+    int *args = &arguments[nodes[nidx].offset];
+    std::vector<int> support;
+    for (int i = 0; i < degree; i++) {
+	int cidx = node_index(args[i]);
+	if (cidx < 0)
+	    support.push_back(get_var(args[i]));
+	else if (tt_index[cidx] < 0)
+	    return TT_LARGE;
+	else {
+	    truth_table &ctt = tt_tables[tt_index[cidx]];
+	    support.insert(support.end(), ctt.support.begin(), ctt.support.end());
+	}
+    }
+    std::sort(support.begin(), support.end());
+    support.erase(std::unique(support.begin(), support.end()), support.end());
+    int k = support.size();
+    if (k > TT_MAX_VARS || tt_words + tt_word_count(k) > TT_MAX_WORDS)
+	return TT_LARGE;
+    bool is_sum = nodes[nidx].type == POG_SUM;
+    int tidx = tt_tables.size();
+    tt_tables.emplace_back();
+    truth_table &tt = tt_tables.back();
+    tt.support = support;
+    tt.bits.assign(tt_word_count(k), is_sum ? 0 : ~0ull);
+    tt.bits[0] &= tt_mask(k);
+    tt_words += tt.bits.size();
+    std::vector<uint64_t> cbits;
+    for (int i = 0; i < degree; i++) {
+	truth_table scratch;
+	const truth_table *ctt = tt_find(args[i], scratch);
+	tt_expand(*ctt, support, args[i] < 0, cbits);
+	if (is_sum)
+	    for (int w = 0; w < cbits.size(); w++)
+		tt.bits[w] |= cbits[w];
+	else
+	    for (int w = 0; w < cbits.size(); w++)
+		tt.bits[w] &= cbits[w];
+    }
+    return tidx;
+}
+
+int Pog::truth_table_satisfiable(std::vector<int> &edges) {
+    std::vector<truth_table> scratch(edges.size());
+    std::vector<const truth_table *> tables;
+    std::vector<int> support;
+    for (int i = 0; i < edges.size(); i++) {
+	const truth_table *tt = tt_find(edges[i], scratch[i]);
+	if (tt == NULL)
+	    return -1;
+	tables.push_back(tt);
+	support.insert(support.end(), tt->support.begin(), tt->support.end());
+    }
+    std::sort(support.begin(), support.end());
+    support.erase(std::unique(support.begin(), support.end()), support.end());
+    int k = support.size();
+    if (k > TT_MAX_VARS)
+	return -1;
+    std::vector<uint64_t> conjunction(tt_word_count(k), ~0ull);
+    std::vector<uint64_t> cbits;
+    for (int i = 0; i < edges.size(); i++) {
+	tt_expand(*tables[i], support, edges[i] < 0, cbits);
+	for (int w = 0; w < cbits.size(); w++)
+	    conjunction[w] &= cbits[w];
+    }
+    for (uint64_t w : conjunction)
+	if (w != 0)
+	    return 1;
+    return 0;
+}
+
+int Pog::truth_table_equal_counts(int edge1, int edge2) {
+    truth_table scratch1, scratch2;
+    const truth_table *tt1 = tt_find(edge1, scratch1);
+    const truth_table *tt2 = tt_find(edge2, scratch2);
+    if (tt1 == NULL || tt2 == NULL)
+	return -1;
+    int k1 = tt1->support.size();
+    int k2 = tt2->support.size();
+    uint64_t count1 = tt_popcount(tt1->bits);
+    if (edge1 < 0)
+	count1 = (1ull << k1) - count1;
+    uint64_t count2 = tt_popcount(tt2->bits);
+    if (edge2 < 0)
+	count2 = (1ull << k2) - count2;
+    // Scale to same number of variables
+    return (count1 << k2) == (count2 << k1) ? 1 : 0;
+}
+
 q25_ptr qmark(q25_ptr q, std::vector<q25_ptr> &qlog) {
     qlog.push_back(q);
     return q;
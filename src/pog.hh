@@ -32,7 +32,9 @@
 #include <unordered_set>
 #include <unordered_map>
 #include <map>
+#include <deque>
 #include <limits.h>
+#include <cstdint>
 
 #include "q25.h"
 
@@ -45,6 +47,18 @@
 
 #define MAX_VARIABLE (2 * 1000 * 1000 * 1000)
 
+// Number of 64-bit words of random input patterns in each round of simulation
+#define SIM_WORDS 4
+// Number of simulation rounds.  Signatures from the first round are kept for all nodes.
+// The others use fresh patterns and are only evaluated, over the cone of the query,
+// when the earlier rounds find no witness.
+#define SIM_ROUNDS 16
+
+// Largest support for which node truth tables are computed
+#define TT_MAX_VARS 16
+// Upper bound on total words of cached truth tables
+#define TT_MAX_WORDS (1 << 23)
+
 typedef enum { POG_NONE, POG_PRODUCT, POG_SUM, POG_NUM } pog_type_t;
 
 
@@ -55,12 +69,21 @@ typedef enum { POG_NONE, POG_PRODUCT, POG_SUM, POG_NUM } pog_type_t;
 //  Variable: 1 <= var <= nvar
 //  POG node values between nvar+1 and TAUTOLOGY-1
 
+// Truth table over sorted list of support variables.
+// Bit m gives function value for the assignment where bit i of m is the value of support[i]
+struct truth_table {
+    std::vector<int> support;
+    std::vector<uint64_t> bits;
+};
+
 struct Node {
     int  offset;  // Offset into list of arguments
     pog_type_t type :      2;
     bool data_only :       1;
     bool projection_only : 1;
-    int degree  :         28;
+    // Arguments of every sum node in cone are mutually exclusive
+    bool deterministic :   1;
+    int degree  :         27;
 };
 
 class Pog {
@@ -73,14 +96,29 @@ private:
     std::vector<Node> nodes;
     // Unique table.  Maps from hash of operation + arguments to edge.
     std::unordered_multimap<unsigned, int> unique_table;
+    // Has set_exclusive been called for the node being built?
+    bool exclusive_arguments;
     // Debugging support
     int trace_variable;
+    // Simulation signatures.  SIM_WORDS words for each input variable and for each node
+    std::vector<uint64_t> sim_input;
+    std::vector<uint64_t> sim_signature;
+    // Number of nodes for which signature has been computed
+    int sim_node_count;
+    // For later rounds: position of node within cone being simulated, or -1, and cone signatures
+    std::vector<int> sim_position;
+    std::vector<uint64_t> sim_cone_signature;
+    // Truth tables for nodes with small support.
+    // Indexed by node index, giving position in tt_tables, TT_UNKNOWN, or TT_LARGE
+    std::vector<int> tt_index;
+    std::deque<truth_table> tt_tables;
+    long tt_words;
     
 
 public:
     
     Pog(int n, std::unordered_set<int> *dvars, std::unordered_set<int> *tvars) 
-    { nvar = n; data_variables = dvars; tseitin_variables = tvars; trace_variable = 0; }
+    { nvar = n; data_variables = dvars; tseitin_variables = tvars; trace_variable = 0; exclusive_arguments = false; sim_node_count = 0; tt_words = 0; }
     ~Pog() {}
 
     bool get_phase(int edge) { return edge > 0; }
@@ -98,13 +136,14 @@ public:
 	return is_node(edge) ?
 	    nodes[node_index(edge)].projection_only :
 	    data_variables->find(get_var(edge)) == data_variables->end(); }
+    bool is_deterministic(int edge) { return is_node(edge) ? nodes[node_index(edge)].deterministic : true; }
 
     int variable_count() { return nvar; }
     int node_count() { return nodes.size(); }
     int edge_count() { return arguments.size(); }
 
     bool is_data_variable(int var) { return data_variables->find(var) != data_variables->end(); }
-    bool is_tseitin_variable(int var) { return tseitin_variables->find(var) != data_variables->end(); }
+    bool is_tseitin_variable(int var) { return tseitin_variables->find(var) != tseitin_variables->end(); }
 
 
     int *get_arguments(int edge) {
@@ -126,6 +165,10 @@ public:
     void add_argument(int edge);
     // Return edge for either newly created or existing node
     int finish_node();
+    // Record that arguments of the sum node being built are known to be mutually exclusive.
+    // Call between start_node and finish_node.  Node becomes deterministic if its arguments are.
+    // Has no effect if finish_node collapses the node to a single argument
+    void set_exclusive();
 
     // Extract subgraph with designated root edge and write to file
     // Can have FILE = NULL, in which case does not actually perform the write
@@ -134,6 +177,18 @@ public:
     // Use to perform both weighted and unweighted model counting
     q25_ptr ring_evaluate(int root_edge, std::unordered_map<int,q25_ptr> &weights);
 
+    // Evaluate POG on up to 64*SIM_WORDS*SIM_ROUNDS random assignments to its variables.
+    // Return true if some assignment satisfies all of the edges.
+    // False means only that the simulation found no witness
+    bool simulate_satisfiable(std::vector<int> &edges);
+
+    // Exact evaluation for edges whose combined support has at most TT_MAX_VARS variables.
+    // Return 1 if conjunction of edges is satisfiable, 0 if not, and -1 if support too large
+    int truth_table_satisfiable(std::vector<int> &edges);
+    // Return 1 if edges have same number of models, 0 if not, and -1 if support too large.
+    // Edges should depend only on data variables
+    int truth_table_equal_counts(int edge1, int edge2);
+
     // Read NNF file and integrate into POG.  Return edge to new root
     // Optionally perform Tseitin trimming
     int load_nnf(FILE *infile, std::unordered_set<int> *data_variables);
@@ -163,10 +218,30 @@ private:
 
     unsigned node_hash(int var);
     bool node_equal(int var1, int var2);
+    // Does sum node have two arguments with complementary top-level literals?
+    bool is_decision(int nidx);
 
     // Create a POG representation of a clause
     int build_disjunction(std::vector<int> &args);
 
+    // Compute signatures for nodes created since last simulation
+    void simulate_extend();
+    // Get pointer to simulation signature of edge's destination.  Caller must complement for negative edge
+    uint64_t *sim_words(int edge);
+    // Evaluate one of the later rounds over cone, which lists node indices in increasing order.
+    // Return true if some assignment satisfies all of the edges
+    bool simulate_round(std::vector<int> &edges, std::vector<int> &cone, int round);
+    // Get pointer to words of edge's destination for later round, using scratch for input variables.
+    // Caller must complement for negative edge
+    const uint64_t *sim_round_words(int edge, int round, uint64_t *scratch);
+
+    // Get truth table for edge's destination, computing it for nodes as needed.
+    // Uses scratch for non-node edges.  Return NULL if support too large
+    const truth_table *tt_find(int edge, truth_table &scratch);
+    // Compute table for node with index nidx once its arguments have been processed.
+    // Return position in tt_tables or TT_LARGE
+    int tt_compute(int nidx);
+
 
 };
 
@@ -29,43 +29,57 @@
 #include "report.h"
 #include "counters.h"
 #include "files.hh"
+#include "reader.hh"
 
-Project::Project(const char *cnf_name, pkc_mode_t md, bool use_d4v2, int preprocess_level, bool tseitin_detect, bool tseitin_promote, int opt, int bkc_limit) {
+Project::Project(const char *cnf_name, pkc_mode_t md, bool use_d4v2, int preprocess_level, bool tseitin_detect, bool tseitin_promote, int opt, int bkc_limit, const char *snapshot_name, int nthreads, int promote_limit, int promote_total_limit, bool polarity) {
     mode = md;
     optlevel = opt;
+    polarity_kc = polarity;
     trace_variable = 0;
     Cnf cnf;
-    FILE *infile = fopen(cnf_name, "r");
-    if (!infile)
+    Reader in;
+    if (!in.open(cnf_name))
 	err(true, "Couldn't open CNF file '%s'\n", cnf_name);
-    if (!cnf.import_file(infile, mode != PKC_COMPILE)) {
-	fclose(infile);
+    bool from_snapshot = in.contents() && is_snapshot(in.contents(), in.remaining());
+    if (from_snapshot && mode == PKC_COMPILE)
+	err(true, "Can't use snapshot '%s' in compile mode\n", cnf_name);
+    char tseitin_mode = tseitin_promote ? 'p' : tseitin_detect ? 'd' : 'n';
+    bool ok = from_snapshot ?
+	cnf.import_snapshot(in.contents(), in.remaining(), preprocess_level, tseitin_mode) :
+	cnf.import_reader(in, mode != PKC_COMPILE);
+    // Decompression failures are only detected when closing
+    if (!in.close())
+	ok = false;
+    if (!ok)
 	err(true, "Couldn't read input file '%s'\n", cnf_name);
-    }
-    fclose(infile);
     fmgr.set_root(cnf_name);
-    report(1, "CNF file loaded %d declared variables, %d clauses, %d data variables\n",
+    report(1, "%s loaded %d declared variables, %d clauses, %d data variables\n",
+	   from_snapshot ? "Snapshot" : "CNF file",
 	   cnf.variable_count(), cnf.current_clause_count(), cnf.data_variables->size());
     int ucount = 0;
     int ecount = 0;
     double pstart = tod();
-    if (preprocess_level >= 1) {
-	ucount = cnf.bcp(true);
-    }
-    if (preprocess_level >= 2) {
-	int maxdegree = preprocess_level >= 3 ? 1 : 0;
-	ecount = cnf.bve(true, maxdegree);
-    }
-    report(1, "Initial BCP/BVE found %d unit literals and eliminated %d variables\n", ucount, ecount);
-    if (tseitin_detect || tseitin_promote) {
-	cnf.classify_variables(tseitin_promote);
-	int tcount = cnf.tseitin_variables->size();
-	report(1, "Variable analysis found and/or created %d Tseitin variables\n", tcount);
-    }
-    if (preprocess_level >= 4) {
-	int maxdegree = preprocess_level - 2;
-	ecount = cnf.bve(true, maxdegree);
-	report(1, "Second BVE (maxdegree %d) eliminated %d variables\n", maxdegree, ecount);
+    // Snapshot has already been preprocessed
+    if (!from_snapshot) {
+	if (preprocess_level >= 1) {
+	    ucount = cnf.bcp(true);
+	}
+	if (preprocess_level >= 2) {
+	    int maxdegree = preprocess_level >= 3 ? 1 : 0;
+	    ecount = cnf.bve(true, maxdegree, nthreads);
+	}
+	report(1, "Initial BCP/BVE found %d unit literals and eliminated %d variables\n", ucount, ecount);
+	if (tseitin_detect || tseitin_promote) {
+	    cnf.set_promote_limits(promote_limit, promote_total_limit);
+	    cnf.classify_variables(tseitin_promote, nthreads);
+	    int tcount = cnf.tseitin_variables->size();
+	    report(1, "Variable analysis found and/or created %d Tseitin variables\n", tcount);
+	}
+	if (preprocess_level >= 4) {
+	    int maxdegree = preprocess_level - 2;
+	    ecount = cnf.bve(true, maxdegree, nthreads);
+	    report(1, "Second BVE (maxdegree %d) eliminated %d variables\n", maxdegree, ecount);
+	}
     }
     incr_count_by(COUNT_UNUSED_VAR, cnf.get_variable_type_count(VAR_UNUSED));
     incr_count_by(COUNT_DATA_VAR, cnf.get_variable_type_count(VAR_DATA));
@@ -79,6 +93,15 @@ Project::Project(const char *cnf_name, pkc_mode_t md, bool use_d4v2, int preproc
 	   get_count(COUNT_NONTSEITIN_VAR));
     incr_timer(TIME_PREPROCESS, tod()-pstart);
     reset_timer(TIME_BCP);
+    if (snapshot_name) {
+	FILE *snap_file = fopen(snapshot_name, "wb");
+	if (!snap_file)
+	    err(true, "Couldn't open snapshot file '%s'\n", snapshot_name);
+	if (!cnf.write_snapshot(snap_file, preprocess_level, tseitin_mode))
+	    err(true, "Couldn't write snapshot file '%s'\n", snapshot_name);
+	fclose(snap_file);
+	report(1, "Wrote preprocessed formula to snapshot file '%s'\n", snapshot_name);
+    }
     if (mode == PKC_PREPROCESS)
 	return;
     pog = new Pog(cnf.variable_count(), cnf.data_variables, cnf.tseitin_variables);
@@ -107,6 +130,10 @@ Project::Project(const char *cnf_name, pkc_mode_t md, bool use_d4v2, int preproc
 Project::~Project() {
     delete pog;
     delete compiler;
+    for (auto iter : density_cache)
+	q25_free(iter.second);
+    for (auto iter : density_weights)
+	q25_free(iter.second);
 }
 
 void Project::projecting_compile(int preprocess_level) {
@@ -137,7 +164,7 @@ void Project::projecting_compile(int preprocess_level) {
 	    ucount = mcnf->bcp(false);
 	    if (preprocess_level >= 2) {
 		int maxdegree = preprocess_level - 2;
-		ecount = mcnf->bve(false, maxdegree);
+		ecount = mcnf->bve(false, maxdegree, 1);
 	    }
 	}
 	report(2, "Recompile.  %d unit literals, %d eliminated variables.  %d variables remain.  %d non-unit clauses\n",
@@ -235,6 +262,13 @@ q25_ptr Project::count(bool weighted) {
 }
 
 bool Project::equal_counts(int root_edge1, int root_edge2) {
+    if (pog->only_data_variables(root_edge1) && pog->only_data_variables(root_edge2)) {
+	int tt_result = pog->truth_table_equal_counts(root_edge1, root_edge2);
+	if (tt_result >= 0) {
+	    incr_count(COUNT_TRUTH_TABLE_COUNT);
+	    return tt_result == 1;
+	}
+    }
     q25_ptr count1 = subgraph_count(false, root_edge1);
     q25_ptr count2 = subgraph_count(false, root_edge2);	
     bool result = q25_compare(count1, count2) == 0;
@@ -242,15 +276,92 @@ bool Project::equal_counts(int root_edge1, int root_edge2) {
     return result;
 }
 
-bool Project::sums_to_tautology(std::vector<int> &root_literals) {
+q25_ptr Project::density(int edge) {
+    if (!pog->only_data_variables(edge) || !pog->is_deterministic(edge))
+	return NULL;
+    auto fid = density_cache.find(edge);
+    if (fid != density_cache.end())
+	return fid->second;
+    if (density_weights.size() == 0) {
+	q25_ptr two = q25_from_32(2);
+	for (int var : *(pog->data_variables)) {
+	    density_weights[ var] = q25_recip(two);
+	    density_weights[-var] = q25_recip(two);
+	}
+	q25_free(two);
+    }
+    double start = tod();
+    q25_ptr val = pog->ring_evaluate(edge, density_weights);
+    incr_timer(TIME_RING_EVAL, tod()-start);
+    density_cache[edge] = val;
+    return val;
+}
+
+int Project::count_tautology(std::vector<int> &root_literals, bool exclusive) {
+    std::vector<q25_ptr> qlog;
+    q25_ptr total = qmark(q25_from_32(0), qlog);
+    for (int root : root_literals) {
+	q25_ptr d = density(root);
+	if (d == NULL) {
+	    qflush(qlog);
+	    return -1;
+	}
+	if (q25_is_one(d)) {
+	    qflush(qlog);
+	    return 1;
+	}
+	total = qmark(q25_add(total, d), qlog);
+    }
+    int cmp = q25_compare(total, qmark(q25_from_32(1), qlog));
+    qflush(qlog);
+    // Densities of exclusive arguments add
+    if (exclusive || root_literals.size() == 1)
+	return cmp == 0 ? 1 : 0;
+    // Otherwise, arguments can only cover all assignments if their densities sum to at least 1
+    return cmp < 0 ? 0 : -1;
+}
+
+int Project::count_mutex(int edge1, int edge2) {
+    q25_ptr d1 = density(edge1);
+    q25_ptr d2 = density(edge2);
+    if (d1 == NULL || d2 == NULL)
+	return -1;
+    if (q25_is_zero(d1) || q25_is_zero(d2))
+	return 1;
+    // Arguments must overlap if their densities sum to more than 1
+    q25_ptr total = q25_add(d1, d2);
+    q25_ptr one = q25_from_32(1);
+    int cmp = q25_compare(total, one);
+    q25_free(total); q25_free(one);
+    return cmp > 0 ? 0 : -1;
+}
+
+bool Project::sums_to_tautology(std::vector<int> &root_literals, bool exclusive) {
+    int count_result = count_tautology(root_literals, exclusive);
+    if (count_result >= 0) {
+	incr_count(COUNT_DETERMINISTIC_TEST);
+	return count_result == 1;
+    }
     std::vector<int> nroot_literals;
     for (int root : root_literals)
 	nroot_literals.push_back(-root);
-    Cnf *tcnf = compiler->clausify(nroot_literals);
-    bool result = !tcnf->is_satisfiable();
-    tcnf->deallocate();
-    delete tcnf;
-    return result;
+    return !satisfiable(nroot_literals);
+}
+
+bool Project::satisfiable(std::vector<int> &root_literals) {
+    // Random simulation can find a witness without calling the SAT solver
+    incr_count(COUNT_SIM_QUERY);
+    if (pog->simulate_satisfiable(root_literals)) {
+	incr_count(COUNT_SIM_HIT);
+	return true;
+    }
+    // Small cones can be decided exactly
+    int tt_result = pog->truth_table_satisfiable(root_literals);
+    if (tt_result >= 0) {
+	incr_count(COUNT_TRUTH_TABLE_SAT);
+	return tt_result == 1;
+    }
+    return compiler->satisfiable(root_literals);
 }
 
 int Project::traverse(int edge) {
@@ -319,7 +430,9 @@ int Project::traverse_sum(int edge) {
     std::vector<int> roots;
     roots.push_back(nedge1);
     roots.push_back(nedge2);
-    if (sums_to_tautology(roots)) {
+    // Splitting on data or Tseitin variable yields mutually exclusive arguments
+    bool exclusive = pog->is_data_variable(dvar) || pog->is_tseitin_variable(dvar);
+    if (sums_to_tautology(roots, exclusive)) {
 	incr_count(COUNT_VISIT_TAUTOLOGY_SUM);
 	report(rlevel, "Traversal Sum node %d yielded edges %d and %d summing to tautology\n", edge, nedge1, nedge2);
 	return TAUTOLOGY;
@@ -334,17 +447,24 @@ int Project::traverse_sum(int edge) {
 	report(rlevel, "Traversing Sum node %d gives child edges %d and %d. Split on Tseitin variable %d\n", edge, nedge1, nedge2, dvar);
     } else {
 	report(rlevel, "Traversing Sum node %d gives child edges %d and %d. Split on projection variable %d\n", edge, nedge1, nedge2, dvar);
-	Cnf *xcnf = compiler->clausify(roots);
-	report(rlevel, "Mutex test.  Traversing edge %d.  Calling SAT solver\n", edge);
-	if (!xcnf->is_satisfiable()) {
+	int mutex = count_mutex(nedge1, nedge2);
+	if (mutex >= 0)
+	    incr_count(COUNT_DETERMINISTIC_TEST);
+	else {
+	    report(rlevel, "Mutex test.  Traversing edge %d.  Calling SAT solver\n", edge);
+	    mutex = satisfiable(roots) ? 0 : 1;
+	}
+	if (mutex == 1) {
 	    descr = "mutex";
+	    exclusive = true;
 	    incr_count(COUNT_VISIT_MUTEX_SUM);
 	} else {
 	    report(rlevel, "Traversing edge %d.  Calling compiler\n", edge);
-	    int uroot = compiler->compile(xcnf, optlevel >= 2, false);
+	    int uroot = compiler->compile_cone(roots, optlevel >= 2, polarity_kc);
 	    if (uroot == CONFLICT) {
 		report(rlevel, "Traversing edge %d.  KC gives conflict\n", edge);
 		descr = "mutex";
+		exclusive = true;
 		incr_count(COUNT_VISIT_MUTEX_SUM);
 	    } else {
 		report(rlevel, "Traversing edge %d.  KC gives edge %d\n", edge, uroot);
@@ -371,25 +491,28 @@ int Project::traverse_sum(int edge) {
 		    incr_count(COUNT_VISIT_COUNTED_SUM);
 		    return nedge1;
 		}
+		// Both sums have mutually exclusive arguments, since xroot is the intersection
 		pog->start_node(POG_SUM);
 		pog->add_argument(-nedge1);
 		pog->add_argument(xroot);
+		pog->set_exclusive();
 		int mroot = pog->finish_node();
 		pog->start_node(POG_SUM);
 		pog->add_argument(-mroot);
 		pog->add_argument(nedge2);
+		pog->set_exclusive();
 		nedge = pog->finish_node();
 		descr = "excluding";
 		incr_count(COUNT_VISIT_EXCLUDING_SUM);
 	    }
 	}
-	xcnf->deallocate();
-	delete xcnf;
     }
     if (nedge == 0) {
 	pog->start_node(POG_SUM);
 	pog->add_argument(nedge1);
 	pog->add_argument(nedge2);
+	if (exclusive)
+	    pog->set_exclusive();
 	nedge = pog->finish_node();
     }
     report(rlevel, "Traversal of Sum node %d yielded edge %d.  Sum type = %s\n", edge, nedge, descr);
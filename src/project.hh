@@ -37,6 +37,10 @@ private:
     int root_literal;
     std::unordered_map<int,int> result_cache;
     std::unordered_map<int,q25_ptr> *input_weights;
+    // Fraction of data assignments satisfying deterministic, data-only edges
+    std::unordered_map<int,q25_ptr> density_cache;
+    // Weight 1/2 for each data literal
+    std::unordered_map<int,q25_ptr> density_weights;
 
     pkc_mode_t mode;
 
@@ -48,11 +52,18 @@ private:
     // 4 : Perform subsumption check when performing sum reductions
     int optlevel;
 
+    // Use polarity-aware encoding for CNFs sent to knowledge compiler when trimming
+    bool polarity_kc;
+
     // Debugging support
     int trace_variable;
 
 public:
-    Project(const char *cnf_name, pkc_mode_t mode, bool use_d4v2, int preprocessing_level, bool tseitin_detect, bool tseitin_promote, int optlevel, int bkc_limit);
+    // CNF file can also be snapshot of preprocessed formula, in which case preprocessing is skipped.
+    // When snapshot_name is non-NULL, write snapshot after preprocessing.
+    // Preprocessing uses nthreads threads
+    // With polarity_kc, CNFs sent to D4 v2 during traversal use polarity-aware encoding
+    Project(const char *cnf_name, pkc_mode_t mode, bool use_d4v2, int preprocessing_level, bool tseitin_detect, bool tseitin_promote, int optlevel, int bkc_limit, const char *snapshot_name, int nthreads, int promote_limit, int promote_total_limit, bool polarity_kc);
     ~Project();
     void projecting_compile(int preprocess_level);
     bool write(const char *pog_name);
@@ -71,7 +82,16 @@ private:
     // Perform ordinary knowledge compilation by invoking D4
 
     // Traversal
-    bool sums_to_tautology(std::vector<int> &root_literals);
+    // Exclusive indicates that the root literals are known to be mutually exclusive
+    bool sums_to_tautology(std::vector<int> &root_literals, bool exclusive = false);
+    // Get density of edge by ring evaluation.  Return NULL unless edge is deterministic and data-only
+    q25_ptr density(int edge);
+    // Count-based tests for deterministic edges.  Return 1 (true), 0 (false), or -1 (unknown)
+    int count_tautology(std::vector<int> &root_literals, bool exclusive);
+    int count_mutex(int edge1, int edge2);
+    // Determine whether conjunction of root literals is satisfiable.
+    // Try random simulation and then truth tables before calling SAT solver
+    bool satisfiable(std::vector<int> &root_literals);
 
     int traverse_sum(int edge);
     int traverse_product(int edge);
@@ -81,7 +101,7 @@ private:
     // Return NULL if weighted but no weights declared
     q25_ptr subgraph_count(bool weighted, int root_edge);
 
-    // Use as part of subsumption check
+    // Use as part of subsumption check.  Compare truth tables when supports are small
     bool equal_counts(int root_edge1, int root_edge2);
 
 };
@@ -655,7 +655,31 @@ q25_ptr q25_mul(q25_ptr q1, q25_ptr q2) {
     return q25_build(WID);
 }
 
-q25_ptr q25_read(FILE *infile) {
+/* Character source for parsing numbers.  Either a file or a string */
+typedef struct {
+    FILE *infile;
+    const char *sbuf;
+    int pos;
+} q25_source_t;
+
+static int source_getc(q25_source_t *src) {
+    if (src->infile)
+	return fgetc(src->infile);
+    int c = src->sbuf[src->pos];
+    if (c == '\0')
+	return EOF;
+    src->pos++;
+    return c;
+}
+
+static void source_ungetc(int c, q25_source_t *src) {
+    if (src->infile)
+	ungetc(c, src->infile);
+    else if (c != EOF)
+	src->pos--;
+}
+
+static q25_ptr q25_parse(q25_source_t *src) {
     /* Fill up digit buffer in reverse order */
     int d = 0;
     q25_check(1, d+1);
@@ -667,7 +691,7 @@ q25_ptr q25_read(FILE *infile) {
     int n10 = 0;
     bool first = true;
     while (true) {
-	int c = fgetc(infile);
+	int c = source_getc(src);
 	if (c == '-') {
 	    if (first) {
 		negative = true;
@@ -675,12 +699,12 @@ q25_ptr q25_read(FILE *infile) {
 		continue;
 	    }
 	    else {
-		ungetc(c, infile);
+		source_ungetc(c, src);
 		break;
 	    }
 	} else if (c == '.') {
 	    if (got_point) {
-		ungetc(c, infile);
+		source_ungetc(c, src);
 		break;
 	    } else
 		got_point = true;
@@ -697,7 +721,7 @@ q25_ptr q25_read(FILE *infile) {
 	    unsigned dig = c - '0';
 	    digit_buffer[1][d] = 10 * digit_buffer[1][d] + dig;
 	} else {
-	    ungetc(c, infile);
+	    source_ungetc(c, src);
 	    break;
 	}
 	first = false;
@@ -705,7 +729,7 @@ q25_ptr q25_read(FILE *infile) {
     bool valid = n10 > 0;
     if (valid) {
 	// See if there's an exponent
-	int c = fgetc(infile);
+	int c = source_getc(src);
 	if (c == 'e') {
 	    // Deal with exponent
 	    bool exp_negative = false;
@@ -713,12 +737,12 @@ q25_ptr q25_read(FILE *infile) {
 	    int exponent = 0;
 	    bool exp_first = true;
 	    while (true) {
-		c = fgetc(infile);
+		c = source_getc(src);
 		if (c == '-') {
 		    if (exp_first)
 			exp_negative = true;
 		    else {
-			ungetc(c, infile);
+			source_ungetc(c, src);
 			valid = false;
 			break;
 		    }
@@ -727,7 +751,7 @@ q25_ptr q25_read(FILE *infile) {
 		    unsigned dig = c - '0';
 		    exponent = 10 * exponent + dig;
 		} else {
-		    ungetc(c, infile);
+		    source_ungetc(c, src);
 		    break;
 		}
 		exp_first = false;
@@ -737,7 +761,7 @@ q25_ptr q25_read(FILE *infile) {
 		exponent = -exponent;
 	    pwr10 += exponent;
 	} else
-	    ungetc(c, infile);
+	    source_ungetc(c, src);
     }
     if (!valid) {
 	q25_set(WID, 0);
@@ -772,6 +796,19 @@ q25_ptr q25_read(FILE *infile) {
     return q25_build(WID);
 }
 
+q25_ptr q25_read(FILE *infile) {
+    q25_source_t src = { infile, NULL, 0 };
+    return q25_parse(&src);
+}
+
+q25_ptr q25_from_string(const char *sbuf, int *lenp) {
+    q25_source_t src = { NULL, sbuf, 0 };
+    q25_ptr q = q25_parse(&src);
+    if (lenp)
+	*lenp = src.pos;
+    return q;
+}
+
 void q25_write(q25_ptr q, FILE *outfile) {
     if (!q->valid) {
 	fprintf(outfile, "INVALID");
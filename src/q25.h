@@ -110,6 +110,9 @@ q25_ptr q25_mul(q25_ptr q1, q25_ptr q2);
 /* Read from file */
 q25_ptr q25_read(FILE *infile);
 
+/* Read from string.  Set *lenp (when non-NULL) to number of characters consumed */
+q25_ptr q25_from_string(const char *sbuf, int *lenp);
+
 /* Write to file */
 void q25_write(q25_ptr q, FILE *outfile);
 
@@ -0,0 +1,286 @@
+/*========================================================================
+  Copyright (c) 2023 Randal E. Bryant, Carnegie Mellon University
+  
+  Permission is hereby granted, free of
+  charge, to any person obtaining a copy of this software and
+  associated documentation files (the "Software"), to deal in the
+  Software without restriction, including without limitation the
+  rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom
+  the Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+========================================================================*/
+
+
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <zlib.h>
+
+#include "report.h"
+#include "reader.hh"
+
+// Size of buffer for streamed input
+#define CHUNK_BYTES (1 << 20)
+
+// Compressed formats handled by piping through an external decompressor
+static const char *pipe_extensions[] = { ".xz", ".zst" };
+static const char *pipe_programs[] = { "xz", "zstd" };
+#define PIPE_FORMATS 2
+
+static bool has_extension(const char *fname, const char *ext) {
+    size_t flen = strlen(fname);
+    size_t elen = strlen(ext);
+    return flen > elen && strcmp(fname + flen - elen, ext) == 0;
+}
+
+Reader::Reader() {
+    source = SOURCE_NONE;
+    fd = -1;
+    map_base = NULL;
+    map_length = 0;
+    stream = NULL;
+    gzstream = NULL;
+    buffer = NULL;
+    child_pid = -1;
+    exhausted = false;
+    failed = false;
+    pos = end = NULL;
+}
+
+Reader::~Reader() {
+    close();
+}
+
+bool Reader::open(const char *fname) {
+    close();
+    bool compressed = has_extension(fname, ".gz");
+    for (int i = 0; i < PIPE_FORMATS; i++)
+	compressed = compressed || has_extension(fname, pipe_extensions[i]);
+    // Pipes and devices can't be memory-mapped
+    struct stat sb;
+    bool regular = stat(fname, &sb) == 0 && S_ISREG(sb.st_mode);
+    if (strcmp(fname, "-") == 0 || compressed || !regular)
+	return open_stream(fname);
+    return open_mmap(fname);
+}
+
+bool Reader::open_mmap(const char *fname) {
+    fd = ::open(fname, O_RDONLY);
+    if (fd < 0)
+	return false;
+    source = SOURCE_MMAP;
+    struct stat sb;
+    if (fstat(fd, &sb) != 0) {
+	close();
+	return false;
+    }
+    map_length = sb.st_size;
+    if (map_length > 0) {
+	void *addr = mmap(NULL, map_length, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (addr == MAP_FAILED) {
+	    err(false, "Couldn't memory-map file '%s'\n", fname);
+	    map_length = 0;
+	    close();
+	    return false;
+	}
+	map_base = (char *) addr;
+	// Single sequential pass
+	madvise(map_base, map_length, MADV_SEQUENTIAL);
+    }
+    pos = map_base;
+    end = map_base + map_length;
+    return true;
+}
+
+bool Reader::open_stream(const char *fname) {
+    if (strcmp(fname, "-") == 0) {
+	source = SOURCE_FILE;
+	stream = stdin;
+    } else if (access(fname, R_OK) != 0) {
+	return false;
+    } else if (has_extension(fname, ".gz")) {
+	gzFile gz = gzopen(fname, "rb");
+	if (gz == NULL)
+	    return false;
+	gzbuffer(gz, CHUNK_BYTES);
+	source = SOURCE_GZIP;
+	gzstream = (void *) gz;
+    } else {
+	for (int i = 0; i < PIPE_FORMATS; i++) {
+	    if (has_extension(fname, pipe_extensions[i])) {
+		const char *argv[] = { pipe_programs[i], "-dc", "--", fname, NULL };
+		if (!open_pipe(argv, fname))
+		    return false;
+		source = SOURCE_PIPE;
+		break;
+	    }
+	}
+	if (stream == NULL) {
+	    // Uncompressed file that can't be memory-mapped
+	    stream = fopen(fname, "rb");
+	    if (stream == NULL)
+		return false;
+	    source = SOURCE_FILE;
+	}
+    }
+    buffer = (char *) malloc(CHUNK_BYTES);
+    pos = end = buffer;
+    return true;
+}
+
+bool Reader::open_pipe(const char *const argv[], const char *fname) {
+    report(3, "Reading input '%s' with %s\n", fname, argv[0]);
+    int fds[2];
+    if (pipe(fds) != 0)
+	return false;
+    child_pid = fork();
+    if (child_pid < 0) {
+	::close(fds[0]);
+	::close(fds[1]);
+	return false;
+    }
+    if (child_pid == 0) {
+	// Child.  Arguments go directly to the program, without shell interpretation
+	dup2(fds[1], STDOUT_FILENO);
+	::close(fds[0]);
+	::close(fds[1]);
+	execvp(argv[0], (char *const *) argv);
+	_exit(127);
+    }
+    ::close(fds[1]);
+    stream = fdopen(fds[0], "rb");
+    if (stream == NULL) {
+	::close(fds[0]);
+	kill(child_pid, SIGTERM);
+	waitpid(child_pid, NULL, 0);
+	child_pid = -1;
+	return false;
+    }
+    return true;
+}
+
+bool Reader::refill() {
+    long n = 0;
+    switch (source) {
+    case SOURCE_FILE:
+    case SOURCE_PIPE:
+	n = fread(buffer, 1, CHUNK_BYTES, stream);
+	break;
+    case SOURCE_GZIP:
+	n = gzread((gzFile) gzstream, buffer, CHUNK_BYTES);
+	if (n < 0) {
+	    int code;
+	    err(false, "Decompression error: %s\n", gzerror((gzFile) gzstream, &code));
+	    failed = true;
+	    n = 0;
+	}
+	break;
+    default:
+	// Memory-mapped input is all present from the start
+	break;
+    }
+    if (n <= 0) {
+	exhausted = true;
+	return false;
+    }
+    pos = buffer;
+    end = buffer + n;
+    return true;
+}
+
+bool Reader::close() {
+    switch (source) {
+    case SOURCE_MMAP:
+	if (map_base)
+	    munmap(map_base, map_length);
+	if (fd >= 0)
+	    ::close(fd);
+	break;
+    case SOURCE_PIPE:
+	{
+	    bool early = !exhausted;
+	    fclose(stream);
+	    int status = 0;
+	    // Closed before end of input.  Decompressor may be killed by SIGPIPE
+	    if (early)
+		kill(child_pid, SIGTERM);
+	    waitpid(child_pid, &status, 0);
+	    child_pid = -1;
+	    if (!early) {
+		if (WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+		    err(false, "Couldn't run decompression program\n");
+		    failed = true;
+		} else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		    err(false, "Decompression program returned error status\n");
+		    failed = true;
+		}
+	    }
+	}
+	break;
+    case SOURCE_GZIP:
+	if (gzclose((gzFile) gzstream) != Z_OK && exhausted) {
+	    err(false, "Error closing compressed input\n");
+	    failed = true;
+	}
+	break;
+    case SOURCE_FILE:
+	// Leave stdin open
+	if (stream != stdin)
+	    fclose(stream);
+	break;
+    default:
+	break;
+    }
+    if (buffer)
+	free(buffer);
+    source = SOURCE_NONE;
+    fd = -1;
+    map_base = NULL;
+    map_length = 0;
+    stream = NULL;
+    gzstream = NULL;
+    buffer = NULL;
+    child_pid = -1;
+    pos = end = NULL;
+    bool ok = !failed;
+    exhausted = false;
+    failed = false;
+    return ok;
+}
+
+int Reader::skip_line() {
+    int c = EOF;
+    while (available()) {
+	c = (unsigned char) *pos++;
+	if (c == '\n')
+	    break;
+    }
+    return c;
+}
+
+int Reader::read_token(char *dest, int maxlen) {
+    skip_blanks();
+    int len = 0;
+    while (available() && !is_space(*pos) && len < maxlen-1)
+	dest[len++] = *pos++;
+    dest[len] = '\0';
+    return len;
+}
@@ -0,0 +1,131 @@
+/*========================================================================
+  Copyright (c) 2023 Randal E. Bryant, Carnegie Mellon University
+  
+  Permission is hereby granted, free of
+  charge, to any person obtaining a copy of this software and
+  associated documentation files (the "Software"), to deal in the
+  Software without restriction, including without limitation the
+  rights to use, copy, modify, merge, publish, distribute, sublicense,
+  and/or sell copies of the Software, and to permit persons to whom
+  the Software is furnished to do so, subject to the following
+  conditions:
+  
+  The above copyright notice and this permission notice shall be
+  included in all copies or substantial portions of the Software.
+  
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+  SOFTWARE.
+========================================================================*/
+
+
+#pragma once
+
+#include <cstdio>
+#include <cstddef>
+
+// Byte-level input for DIMACS parsing.
+// Plain files are memory-mapped and parsed in place, without stdio buffering.
+// Compressed files (.gz, .xz, .zst) and standard input ("-") are
+// decompressed or read in chunks into a buffer that feeds the parser directly
+class Reader {
+private:
+    typedef enum { SOURCE_NONE, SOURCE_MMAP, SOURCE_FILE, SOURCE_PIPE, SOURCE_GZIP } source_t;
+    source_t source;
+    // Memory-mapped input
+    int fd;
+    char *map_base;
+    size_t map_length;
+    // Streamed input
+    FILE *stream;
+    void *gzstream;
+    char *buffer;
+    // Decompressor process feeding stream
+    int child_pid;
+    // Reached end of streamed input
+    bool exhausted;
+    // Error detected while reading
+    bool failed;
+    // Unconsumed portion of the input
+    const char *pos;
+    const char *end;
+
+public:
+    Reader();
+    ~Reader();
+
+    // Open named file, or standard input when name is "-".
+    // Return false if can't open
+    bool open(const char *fname);
+    // Return false if an error occurred while reading the input,
+    // e.g., the decompressor failed or the compressed data were corrupt
+    bool close();
+
+    // Number of bytes not yet consumed.  Only known for memory-mapped files.  Otherwise 0
+    size_t remaining() { return source == SOURCE_MMAP ? end - pos : 0; }
+    // Unconsumed bytes of memory-mapped file.  NULL for streams
+    const char *contents() { return source == SOURCE_MMAP ? pos : NULL; }
+
+    // Next character, without consuming it.  EOF at end of input
+    int peek() { return available() ? (unsigned char) *pos : EOF; }
+    // Consume and return next character
+    int get() { return available() ? (unsigned char) *pos++ : EOF; }
+
+    // Skip over spaces, newlines, etc.  Return next character without consuming it
+    int skip_space() {
+	while (available() && is_space(*pos))
+	    pos++;
+	return peek();
+    }
+
+    // Skip spaces and tabs, but stay on current line.
+    // Return next character without consuming it
+    int skip_blanks() {
+	while (available() && (*pos == ' ' || *pos == '\t' || *pos == '\r'))
+	    pos++;
+	return peek();
+    }
+
+    // Consume through end of line.  Return last character consumed
+    int skip_line();
+
+    // Skip whitespace and read decimal integer with optional sign.
+    // Return false if no number found
+    bool read_int(int *val) {
+	skip_space();
+	bool negative = false;
+	if (available() && (*pos == '-' || *pos == '+')) {
+	    negative = *pos == '-';
+	    pos++;
+	}
+	if (!available() || !is_digit(*pos))
+	    return false;
+	int x = 0;
+	while (available() && is_digit(*pos))
+	    x = 10 * x + (*pos++ - '0');
+	*val = negative ? -x : x;
+	return true;
+    }
+
+    // Read whitespace-delimited token from current line into dest.
+    // Return length of token (0 if none)
+    int read_token(char *dest, int maxlen);
+
+private:
+    // Make sure there is at least one unconsumed character
+    bool available() { return pos < end || refill(); }
+    // Get next chunk of streamed input.  Return false when input exhausted
+    bool refill();
+    bool open_mmap(const char *fname);
+    bool open_stream(const char *fname);
+    // Run decompressor on file, with its output connected to stream
+    bool open_pipe(const char *const argv[], const char *fname);
+
+    static bool is_space(char c) { return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f' || c == '\v'; }
+    static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+};